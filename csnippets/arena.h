@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2013 Ahmed Samy  <f.fallen45@gmail.com>
+ * Licensed under MIT, see LICENSE.MIT for details.
+ */
+#ifndef _ARENA_H
+#define _ARENA_H
+
+/**
+ * Arenas (or regions): memory is taken from big chunks by moving a pointer
+ * forward, and is given back all at once with arena_reset() or
+ * arena_restore(), there is no per-object free.
+ *
+ * This is meant for request-scoped work (parsing a packet, building a
+ * reply, splitting a string): allocate as you go, then throw everything
+ * away in O(1) instead of calling free() on each object.
+ *
+ * Chunks are kept around after a reset, so an arena that is reused for
+ * similar work stops touching the heap after the first round.
+ *
+ * Example:
+ *	arena_t a;
+ *	arena_mark_t m;
+ *
+ *	arena_init(&a, 0);
+ *	m = arena_save(&a);
+ *	char *tmp = arena_strdup(&a, "scratch");
+ *	...
+ *	arena_restore(&a, m);	(tmp is gone)
+ *	...
+ *	arena_free(&a);
+ */
+#define ARENA_ALIGN		16
+#define ARENA_CHUNK_SIZE	(64 * 1024)
+
+struct arena_chunk {
+	struct arena_chunk *next;
+	char *end;
+	char data[];
+};
+
+typedef struct arena {
+	char *pos, *end;		/* free space in the current chunk */
+	struct arena_chunk *cur, *head;
+	size_t chunk_size;
+} arena_t;
+
+/* A position in an arena, see arena_save().  */
+typedef struct arena_mark {
+	struct arena_chunk *chunk;
+	char *pos;
+} arena_mark_t;
+
+#define ARENA_INITIALIZER	{ NULL, NULL, NULL, NULL, ARENA_CHUNK_SIZE }
+
+/**
+ * arena_init - initialize an empty arena
+ * @chunk_size: size of the chunks taken from the heap, 0 for the default
+ *
+ * Nothing is allocated until the first arena_alloc().
+ */
+extern void arena_init(arena_t *a, size_t chunk_size);
+/* Give all the chunks back to the heap.  */
+extern void arena_free(arena_t *a);
+
+extern void *arena_alloc_slow(arena_t *a, size_t size);
+
+/**
+ * arena_alloc - allocate @size bytes aligned to ARENA_ALIGN
+ *
+ * Returns NULL if we ran out of memory.  The memory is not zeroed, see
+ * arena_zalloc().
+ */
+static inline void *arena_alloc(arena_t *a, size_t size)
+{
+	char *p = a->pos;
+	size_t sz = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+	/* sz - 1 also sends 0 (and overflows) to the slow path.  */
+	if (likely(sz - 1 < (size_t)(a->end - p))) {
+		a->pos = p + sz;
+		return p;
+	}
+
+	return arena_alloc_slow(a, size);
+}
+
+static inline void *arena_zalloc(arena_t *a, size_t size)
+{
+	void *p = arena_alloc(a, size);
+
+	if (p)
+		memset(p, 0, size);
+	return p;
+}
+
+/* Save the current position, everything allocated after this can be
+ * released with arena_restore().  Marks nest like a stack.  */
+static inline arena_mark_t arena_save(const arena_t *a)
+{
+	arena_mark_t m = { a->cur, a->pos };
+	return m;
+}
+
+/* Release everything allocated since @m was saved.  */
+static inline void arena_restore(arena_t *a, arena_mark_t m)
+{
+	a->cur = m.chunk;
+	a->pos = m.pos;
+	a->end = m.chunk ? m.chunk->end : NULL;
+}
+
+/* Release everything, the chunks are kept for reuse.  */
+static inline void arena_reset(arena_t *a)
+{
+	a->cur = NULL;
+	a->pos = a->end = NULL;
+}
+
+extern void *arena_memdup(arena_t *a, const void *p, size_t size);
+extern char *arena_strndup(arena_t *a, const char *s, size_t n);
+extern char *arena_strdup(arena_t *a, const char *s);
+
+/**
+ * arena_thread - this thread's own arena
+ *
+ * Created on first use and freed when the thread exits, so there is no
+ * locking.  Code using it should put things back the way it found them
+ * with arena_save() / arena_restore().  Returns NULL if we ran out of
+ * memory.
+ */
+extern arena_t *arena_thread(void);
+
+#endif /* _ARENA_H */
@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2013 Ahmed Samy  <f.fallen45@gmail.com>
+ * Licensed under MIT, see LICENSE.MIT for details.
+ */
+#ifndef _BPTREE_H
+#define _BPTREE_H
+
+/**
+ * In-memory B+trees, an ordered map with the same operations as rb_tree
+ * (see rbtree.h) but laid out for the cache: each node holds up to
+ * BPTREE_ORDER keys in a contiguous array, so a lookup touches a handful
+ * of nodes instead of one scattered node per level, and all the entries
+ * live in leaves that are linked together for in-order scans.
+ *
+ * Keys and infos are pointers, like in rb_tree.  When @compare is NULL,
+ * keys are integers cast to void * and are compared inline.
+ *
+ * Positions in the tree are given by a cursor (leaf + index) which stays
+ * valid until the tree is modified.  Keys may be repeated.
+ */
+#define BPTREE_ORDER	32	/* 256 bytes (4 cache lines) of keys per node */
+
+typedef struct bp_node {
+	bool leaf;
+	int n;				/* number of keys */
+	struct bp_inner *parent;
+	void *keys[BPTREE_ORDER];
+} bp_node;
+
+/* child[i] <= keys[i] <= child[i + 1]  */
+typedef struct bp_inner {
+	bp_node h;
+	bp_node *child[BPTREE_ORDER + 1];
+} bp_inner;
+
+typedef struct bp_leaf {
+	bp_node h;
+	void *infos[BPTREE_ORDER];
+	struct bp_leaf *prev, *next;
+} bp_leaf;
+
+typedef struct bp_tree {
+	bp_node *root;
+	size_t count;
+
+	int (*compare) (const void *, const void *);
+	void (*destroy_key) (void *);
+	void (*destroy_info) (void *);
+} bp_tree;
+
+typedef struct bp_cursor {
+	bp_leaf *leaf;
+	int pos;
+} bp_cursor;
+
+/**
+ * bptree_create - create an empty tree
+ * @compare: returns < 0, 0 or > 0; NULL for integer keys
+ * @destroy_key, @destroy_info: called on removal and destroy, may be NULL
+ */
+extern bp_tree *bptree_create(int (*compare) (const void *, const void *),
+			      void (*destroy_key) (void *),
+			      void (*destroy_info) (void *));
+extern void bptree_destroy(bp_tree *);
+
+/* Returns false if we ran out of memory.  */
+extern bool bptree_insert(bp_tree *, void *key, void *info);
+/* Removes the entry at @c, which is no longer valid afterwards.  */
+extern void bptree_remove(bp_tree *, bp_cursor *c);
+
+/*
+ * Searches place @c on the entry found and return true, or return false
+ * if there is no such entry.
+ */
+extern bool bptree_query(bp_tree *, const void *key, bp_cursor *c);
+/* First entry >= @key.  */
+extern bool bptree_lower_bound(bp_tree *, const void *key, bp_cursor *c);
+/* First entry > @key.  */
+extern bool bptree_upper_bound(bp_tree *, const void *key, bp_cursor *c);
+extern bool bptree_first(bp_tree *, bp_cursor *c);
+extern bool bptree_last(bp_tree *, bp_cursor *c);
+
+/* Move @c to the next or previous entry, false at the end.  */
+static inline bool bptree_successor(bp_cursor *c)
+{
+	if (++c->pos < c->leaf->h.n)
+		return true;
+	if (!c->leaf->next)
+		return false;
+	c->leaf = c->leaf->next;
+	c->pos = 0;
+	return true;
+}
+
+static inline bool bptree_predecessor(bp_cursor *c)
+{
+	if (c->pos > 0) {
+		c->pos--;
+		return true;
+	}
+	if (!c->leaf->prev)
+		return false;
+	c->leaf = c->leaf->prev;
+	c->pos = c->leaf->h.n - 1;
+	return true;
+}
+
+static inline void *bptree_key(const bp_cursor *c)
+{
+	return c->leaf->h.keys[c->pos];
+}
+
+static inline void *bptree_info(const bp_cursor *c)
+{
+	return c->leaf->infos[c->pos];
+}
+
+/**
+ * bptree_range - call @fn on every entry in [@lo, @hi), in order
+ *
+ * Returns the number of entries visited.
+ *
+ * Example:
+ *	static void print(void *key, void *info, void *arg)
+ *	{
+ *		printf("%ld\n", (long)key);
+ *	}
+ *	...
+ *	bptree_range(tree, (void *)10, (void *)20, print, NULL);
+ */
+extern size_t bptree_range(bp_tree *, const void *lo, const void *hi,
+			   void (*fn) (void *key, void *info, void *arg),
+			   void *arg);
+
+#endif /* _BPTREE_H */
@@ -5,7 +5,21 @@
 #ifndef _BUFFER_H
 #define _BUFFER_H
 
-typedef struct buffer buffer_t;
+/*
+ * A byte buffer: data[0, wpos) is what was written, and reading happens
+ * at rpos.  size is the allocated capacity, which grows geometrically so
+ * that appending is amortized O(1).
+ *
+ * A buffer from balloc_mmap() is a read-only mapping of a file, the first
+ * write copies it to the heap.
+ */
+typedef struct buffer {
+	size_t wpos, rpos, size;
+	uint8_t *data;
+	bool mapped;
+	bool error;		/* a read went past wpos, see berror() */
+} buffer_t;
+
 /* See bseek() for more information.  */
 typedef enum seektype {
 	seek_start,
@@ -13,11 +27,11 @@ typedef enum seektype {
 	seek_end
 } seektype_t;
 
-/* balloc(int size) - Allocate buffer of @size
+/* balloc(size) - Allocate buffer of @size
  *
  * Returns a malloc'd buffer.
  */
-extern buffer_t *balloc(int bsize);
+extern buffer_t *balloc(size_t bsize);
 
 /* balloc_fp(const char *f) - Allocate buffer and store
  * the file data to the buffer's memory.
@@ -27,9 +41,36 @@ extern buffer_t *balloc(int bsize);
  */
 extern buffer_t *balloc_fp(const char *f);
 
+/* balloc_mmap(f, sequential) - Map the file @f read-only instead of
+ * reading it.
+ *
+ * Pages are read in by the kernel as they are touched, so loading is
+ * O(1) and the memory can be reclaimed under pressure.  If @sequential,
+ * the kernel is told the file will be read from start to end
+ * (MADV_SEQUENTIAL: aggressive readahead, pages dropped behind), otherwise
+ * that all of it will be needed soon (MADV_WILLNEED).
+ *
+ * All the readers work as usual.  Writing copies the file to the heap
+ * first, it never modifies the file.  Falls back to balloc_fp() where
+ * mmap is not available.
+ *
+ * Returns NULL on failure, see errno.
+ */
+extern buffer_t *balloc_mmap(const char *f, bool sequential);
+
 /* bfree(bp) - Free @b's memory.  */
 extern void      bfree(buffer_t *bp);
 
+/* breserve(bp, size) - Make room for @size more bytes after the
+ * current write position.
+ *
+ * After this, up to @size bytes can be added with the unchecked
+ * writers below (__baddc() etc.) which don't check the capacity.
+ *
+ * Returns false if we ran out of memory.
+ */
+extern bool	breserve(buffer_t *bp, size_t size);
+
 /* bwrite(bp, const char *f) - Write @bp's data into
  * the file @f
  *
@@ -50,7 +91,25 @@ extern bool	bwrite(buffer_t *bp, const char *f);
  *
  * Returns the current read position of a buffer.
  */
-extern int      btell(buffer_t *bp);
+extern size_t   btell(buffer_t *bp);
+
+/*
+ * Readers.
+ *
+ * The bget*() functions check that the value is there (before wpos): if
+ * not, they return 0, don't move the read position and set a sticky error
+ * flag.  So a whole message can be decoded without looking at each result,
+ * then checked once with berror().
+ *
+ * For hot loops, check the length of the whole message once with bneed()
+ * and use the unchecked inline readers (__bgetc() etc.) on it.
+ *
+ * Example:
+ *	if (!bneed(bp, 2 + 4))
+ *		return false;
+ *	type = __bget16(bp);
+ *	len = __bget32(bp);
+ */
 
 /* bgetc(bp) - Get an unsigned character from a buffer
  *
@@ -95,7 +154,224 @@ extern void	badd32(buffer_t *bp, uint32_t val);
  *
  * This is an extension function.
  */
-extern void	baddbytes(buffer_t *bp, uint8_t *bytes, size_t size);
+extern void	baddbytes(buffer_t *bp, const void *bytes, size_t size);
+
+/* bget64(bp), bgetfloat(bp), bgetdouble(bp) - Same as bget32() for
+ * 64-bit integers and IEEE 754 floats, all little endian.  */
+extern uint64_t bget64(buffer_t *bp);
+extern float	bgetfloat(buffer_t *bp);
+extern double	bgetdouble(buffer_t *bp);
+
+/* badd64(bp, val), baddfloat(bp, val), badddouble(bp, val) - Same as
+ * badd32() for 64-bit integers and IEEE 754 floats.  */
+extern void	badd64(buffer_t *bp, uint64_t val);
+extern void	baddfloat(buffer_t *bp, float val);
+extern void	badddouble(buffer_t *bp, double val);
+
+/* baddvar(bp, val) - Add @val as an unsigned LEB128 varint: 7 bits per
+ * byte, low bits first, the high bit is set on all bytes but the last.
+ * Values below 128 take one byte, a full u64 takes 10.  bgetvar() fails
+ * (see berror()) on longer encodings and ones that overflow 64 bits.
+ *
+ * baddsvar() zigzag-encodes signed values first so that small negative
+ * numbers are short too (0, -1, 1, -2... become 0, 1, 2, 3...).
+ */
+#define BVAR_MAX	10
+extern void	baddvar(buffer_t *bp, uint64_t val);
+extern void	baddsvar(buffer_t *bp, int64_t val);
+extern uint64_t bgetvar(buffer_t *bp);
+extern int64_t	bgetsvar(buffer_t *bp);
+
+/* baddstr(bp, str, len) - Add @len bytes of @str prefixed by their
+ * length as a varint.
+ *
+ * bgetstr(bp, &len) returns a pointer to the string inside the buffer
+ * (not nul-terminated, no copy is made) and stores its length in @len,
+ * or NULL if the string is cut short.
+ */
+extern void	baddstr(buffer_t *bp, const char *str, size_t len);
+extern const char *bgetstr(buffer_t *bp, size_t *len);
+
+/* badd16s(bp, vals, n) etc. - Add @n integers from @vals.
+ * bget16s(bp, vals, n) etc. - Read @n integers into @vals, which is left
+ * alone if there are less than @n.
+ *
+ * These are a single memcpy() on little endian hosts.
+ */
+extern void	badd16s(buffer_t *bp, const uint16_t *vals, size_t n);
+extern void	badd32s(buffer_t *bp, const uint32_t *vals, size_t n);
+extern void	badd64s(buffer_t *bp, const uint64_t *vals, size_t n);
+extern void	bget16s(buffer_t *bp, uint16_t *vals, size_t n);
+extern void	bget32s(buffer_t *bp, uint32_t *vals, size_t n);
+extern void	bget64s(buffer_t *bp, uint64_t *vals, size_t n);
+
+/* Little endian loads and stores at any alignment.  */
+static inline uint16_t __bload16(const uint8_t *p)
+{
+#ifdef HAVE_LITTLE_ENDIAN
+	uint16_t v;
+	memcpy(&v, p, 2);
+	return v;
+#else
+	return p[0] | p[1] << 8;
+#endif
+}
+
+static inline uint32_t __bload32(const uint8_t *p)
+{
+#ifdef HAVE_LITTLE_ENDIAN
+	uint32_t v;
+	memcpy(&v, p, 4);
+	return v;
+#else
+	return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+#endif
+}
+
+static inline uint64_t __bload64(const uint8_t *p)
+{
+#ifdef HAVE_LITTLE_ENDIAN
+	uint64_t v;
+	memcpy(&v, p, 8);
+	return v;
+#else
+	return __bload32(p) | (uint64_t)__bload32(p + 4) << 32;
+#endif
+}
+
+static inline void __bstore16(uint8_t *p, uint16_t v)
+{
+#ifdef HAVE_LITTLE_ENDIAN
+	memcpy(p, &v, 2);
+#else
+	p[0] = (uint8_t)v;
+	p[1] = v >> 8;
+#endif
+}
+
+static inline void __bstore32(uint8_t *p, uint32_t v)
+{
+#ifdef HAVE_LITTLE_ENDIAN
+	memcpy(p, &v, 4);
+#else
+	__bstore16(p, (uint16_t)v);
+	__bstore16(p + 2, v >> 16);
+#endif
+}
+
+static inline void __bstore64(uint8_t *p, uint64_t v)
+{
+#ifdef HAVE_LITTLE_ENDIAN
+	memcpy(p, &v, 8);
+#else
+	__bstore32(p, (uint32_t)v);
+	__bstore32(p + 4, v >> 32);
+#endif
+}
+
+/* Number of bytes left to read.  */
+static inline size_t bremaining(const buffer_t *bp)
+{
+	return bp->rpos < bp->wpos ? bp->wpos - bp->rpos : 0;
+}
+
+/* berror(bp) - True if a read went past the written data since the
+ * buffer was allocated or bp->error was last cleared.  */
+static inline bool berror(const buffer_t *bp)
+{
+	return bp->error;
+}
+
+/* bneed(bp, size) - Check that @size bytes can be read, after this they
+ * can be read with the unchecked readers.  Sets the error flag if not.  */
+static inline bool bneed(buffer_t *bp, size_t size)
+{
+	if (likely(size <= bremaining(bp)))
+		return true;
+	bp->error = true;
+	return false;
+}
+
+/* Unchecked readers, see bneed().  */
+static inline uint8_t __bgetc(buffer_t *bp)
+{
+	return bp->data[bp->rpos++];
+}
+
+static inline uint16_t __bget16(buffer_t *bp)
+{
+	uint16_t v = __bload16(&bp->data[bp->rpos]);
+
+	bp->rpos += 2;
+	return v;
+}
+
+static inline uint32_t __bget32(buffer_t *bp)
+{
+	uint32_t v = __bload32(&bp->data[bp->rpos]);
+
+	bp->rpos += 4;
+	return v;
+}
+
+static inline uint64_t __bget64(buffer_t *bp)
+{
+	uint64_t v = __bload64(&bp->data[bp->rpos]);
+
+	bp->rpos += 8;
+	return v;
+}
+
+/*
+ * Unchecked writers, the caller must have made room with breserve()
+ * (BVAR_MAX bytes for a varint).
+ *
+ * Example:
+ *	if (!breserve(bp, 1 + 4))
+ *		return false;
+ *	__baddc(bp, type);
+ *	__badd32(bp, len);
+ */
+static inline void __baddc(buffer_t *bp, uint8_t byte)
+{
+	bp->data[bp->wpos++] = byte;
+}
+
+static inline void __badd16(buffer_t *bp, uint16_t val)
+{
+	__bstore16(&bp->data[bp->wpos], val);
+	bp->wpos += 2;
+}
+
+static inline void __badd32(buffer_t *bp, uint32_t val)
+{
+	__bstore32(&bp->data[bp->wpos], val);
+	bp->wpos += 4;
+}
+
+static inline void __badd64(buffer_t *bp, uint64_t val)
+{
+	__bstore64(&bp->data[bp->wpos], val);
+	bp->wpos += 8;
+}
+
+static inline void __baddvar(buffer_t *bp, uint64_t val)
+{
+	uint8_t *p = &bp->data[bp->wpos];
+
+	while (val >= 0x80) {
+		*p++ = (uint8_t)val | 0x80;
+		val >>= 7;
+	}
+	*p++ = (uint8_t)val;
+	bp->wpos = p - bp->data;
+}
+
+static inline void __baddbytes(buffer_t *bp, const void *bytes, size_t size)
+{
+	memcpy(&bp->data[bp->wpos], bytes, size);
+	bp->wpos += size;
+}
 
 /* bskip(bp, size) - Skip data of @size
  *
@@ -34,6 +34,14 @@
 #define GCC_VERSION (__GNUC__ * 10000 \
                      + __GNUC_MINOR__ * 100 \
                      + __GNUC_PATCHLEVEL__)
+/* Build an AVX2 clone of a function next to the default one and pick the
+ * right one at load time (needs ifunc support, so ELF only).  */
+#if (defined __x86_64__ || defined __i386__) && defined __ELF__ \
+	&& !defined __clang__ && GCC_VERSION >= 60000
+#define __simd_clones	__attribute__((target_clones("avx2", "default")))
+#else
+#define __simd_clones
+#endif
 #if GCC_VERSION < 40500 || !defined __clang__
 #define __builtin_unreachable() do { fatal("Something went tottaly unexpected!\n"); } while (0)
 #endif  /* GCC_VERSION */
@@ -57,6 +65,7 @@
 #define __exit
 #define __construct
 #define __destruct
+#define __simd_clones
 #define __builtin_unreachable() do { fatal("Something went tottaly unexpected!\n"); } while (0)
 #warning "Some features might not work since your compiler is not supported"
 #endif  /* __GNUC__ || __clang__ */
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2013 Ahmed Samy  <f.fallen45@gmail.com>
+ * Licensed under MIT, see LICENSE.MIT for details.
+ */
+#ifndef _GLOBSET_H
+#define _GLOBSET_H
+
+/**
+ * Glob sets, match a string against many wildcard patterns at once.
+ *
+ * The patterns use the syntax and case folding of strwildmatch().  They
+ * are compiled together into one automaton that's run over the string a
+ * single time, whatever the number of patterns, and reports the ids of
+ * all the patterns that matched.
+ *
+ * Every pattern character is a state (a bit), and all the states of all
+ * the patterns are stepped together a machine word at a time, so
+ * matching costs about len(str) * (total pattern length / 64) word
+ * operations.  It stops early once no pattern can match anymore.
+ *
+ * Example:
+ *	globset_t *g = globset_new();
+ *	int ids[8], i, n;
+ *
+ *	globset_add(g, "*.example.com", 1);
+ *	globset_add(g, "mail.*", 2);
+ *	globset_compile(g);
+ *
+ *	n = globset_match(g, host, ids, 8);
+ *	if (n < 0)
+ *		...
+ *	for (i = 0; i < n && i < 8; i++)
+ *		...
+ *	globset_free(g);
+ */
+typedef struct globset globset_t;
+
+/* Returns NULL if we ran out of memory.  */
+extern globset_t *globset_new(void);
+extern void globset_free(globset_t *g);
+
+/* Add @pattern with the id @id, the set must be compiled again before
+ * matching.  Returns false if we ran out of memory.  */
+extern bool globset_add(globset_t *g, const char *pattern, int id);
+/* Build the automaton, false if we ran out of memory.  Case folding uses
+ * the current locale.  */
+extern bool globset_compile(globset_t *g);
+
+/**
+ * globset_match - match @str against all the patterns
+ *
+ * Stores the ids of up to @max matching patterns in @ids, in the order
+ * they were added.  Returns the number of patterns that matched, which
+ * may be more than @max, or -1 if the set wasn't compiled since the last
+ * globset_add() or we ran out of memory.  Callers using the set to deny
+ * must treat -1 as a failure, not as no match.
+ */
+extern int globset_match(const globset_t *g, const char *str, int *ids, int max);
+extern int globset_matchn(const globset_t *g, const char *str, size_t len,
+			  int *ids, int max);
+
+#endif /* _GLOBSET_H */
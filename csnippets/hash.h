@@ -113,31 +113,6 @@
  */
 uint32_t hash_u32(const uint32_t *key, size_t num, uint32_t base);
 
-/**
- * hash_string - very fast hash of an ascii string
- * @str: the nul-terminated string
- *
- * The string is hashed, using a hash function optimized for ASCII and
- * similar strings.  It's weaker than the other hash functions.
- *
- * This hash may have different results on different machines, so is
- * only useful for internal hashes (ie. not hashes sent across the
- * network or saved to disk).  The results will be different from the
- * other hash functions in this module, too.
- */
-static inline uint32_t hash_string(const char *string)
-{
-	/* This is Karl Nelson <kenelson@ece.ucdavis.edu>'s X31 hash.
-	 * It's a little faster than the (much better) lookup3 hash(): 56ns vs
-	 * 84ns on my 2GHz Intel Core Duo 2 laptop for a 10 char string. */
-	uint32_t ret;
-
-	for (ret = 0; *string; string++)
-		ret = (ret << 5) - ret + *string;
-
-	return ret;
-}
-
 /**
  * hash64 - fast 64-bit hash of an array for internal use
  * @p: the array or pointer to first element
@@ -253,6 +228,154 @@ uint64_t hash64_stable_32(const void *key, size_t n, uint64_t base);
 uint64_t hash64_stable_16(const void *key, size_t n, uint64_t base);
 uint64_t hash64_stable_8(const void *key, size_t n, uint64_t base);
 
+/**
+ * struct hash_state - incremental hash_any() and hash64_any()
+ *
+ * lookup3 mixes the key's length into its initial state, so the total
+ * length has to be given to the init function; apart from that the key
+ * can be fed in arbitrary pieces and the result is the same as hashing
+ * it in one go.  Only up to 12 bytes are ever buffered, so payloads can
+ * be hashed as they arrive without reassembling them.
+ *
+ * See struct hash64_fast_state when the length isn't known in advance.
+ *
+ * Example:
+ *	struct hash_state st;
+ *
+ *	hash_any_init(&st, total, 0);
+ *	while ((n = conn_read(conn, buf, sizeof(buf))) > 0)
+ *		hash_any_update(&st, buf, n);
+ *	shard = hash_any_final(&st) % nshards;
+ */
+struct hash_state {
+	uint32_t a, b, c;
+	uint32_t base;
+	size_t length, seen;
+	size_t pending;
+	uint8_t buf[12];
+};
+
+/* @length is the total number of bytes that will be fed with update.  */
+void hash_any_init(struct hash_state *st, size_t length, uint32_t base);
+void hash_any_update(struct hash_state *st, const void *data, size_t len);
+uint32_t hash_any_final(const struct hash_state *st);
+
+void hash64_any_init(struct hash_state *st, size_t length, uint64_t base);
+#define hash64_any_update hash_any_update
+uint64_t hash64_any_final(const struct hash_state *st);
+
+/**
+ * hash_u32_many - hash_u32() of several keys at once
+ * @keys: @count keys of @num uint32_t each, laid out one after another
+ * @num: the number of elements in each key
+ * @count: the number of keys
+ * @base: the base number to roll into every hash (usually 0)
+ * @hashes: where to store the @count results
+ *
+ * Gives exactly the same results as calling hash_u32() on each key, but
+ * hashes several keys in parallel SIMD lanes.
+ *
+ * Example:
+ *	// Hash 1000 (src, dst) pairs.
+ *	uint32_t pairs[1000][2], h[1000];
+ *
+ *	hash_u32_many(&pairs[0][0], 2, 1000, 0, h);
+ */
+void hash_u32_many(const uint32_t *keys, size_t num, size_t count,
+		   uint32_t base, uint32_t *hashes);
+
+/**
+ * hash_any_many - hash_any() of several keys at once
+ * @keys: array of @count pointers to the keys
+ * @lengths: array of @count key lengths, in bytes
+ * @count: the number of keys
+ * @base: the base number to roll into every hash (usually 0)
+ * @hashes: where to store the @count results
+ *
+ * Gives exactly the same results as calling hash_any() on each key.
+ * Keys are hashed in parallel SIMD lanes when consecutive keys have the
+ * same length (ids, tuples, ...); keys of mixed lengths are hashed one at
+ * a time.
+ */
+void hash_any_many(const void *const *keys, const size_t *lengths,
+		   size_t count, uint32_t base, uint32_t *hashes);
+
+/**
+ * hash64_any_many - hash64_any() of several keys at once
+ *
+ * See hash_any_many().
+ */
+void hash64_any_many(const void *const *keys, const size_t *lengths,
+		     size_t count, uint64_t base, uint64_t *hashes);
+
+/**
+ * hash64_fast - high-throughput 64-bit hash of an array for internal use
+ * @p: the array or pointer to first element
+ * @num: the number of elements to hash
+ * @base: the 64-bit base number to roll into the hash (usually 0)
+ *
+ * A wyhash-style hash: 16 bytes at a time go through a 64x64->128 bit
+ * multiply, and long keys run three of those chains in parallel.  It's
+ * several times faster than hash64() on anything longer than a few words
+ * and keys of up to 16 bytes take a couple of multiplies.
+ *
+ * This hash will have different results on different machines, so is
+ * only useful for internal hashes (ie. not hashes sent across the
+ * network or saved to disk).
+ *
+ * See also: hash64, hash64_fast_init.
+ */
+#define hash64_fast(p, num, base) hash64_fast_any((p), (num)*sizeof(*(p)), (base))
+
+uint64_t hash64_fast_any(const void *key, size_t length, uint64_t base);
+
+/**
+ * struct hash64_fast_state - incremental hash64_fast_any()
+ *
+ * Hashing a message in pieces gives exactly the same result as
+ * hash64_fast_any() over the concatenation, however the message is
+ * split, without knowing the total length in advance.
+ *
+ * Example:
+ *	struct hash64_fast_state st;
+ *	ssize_t n;
+ *
+ *	hash64_fast_init(&st, 0);
+ *	while ((n = read(fd, buf, sizeof(buf))) > 0)
+ *		hash64_fast_update(&st, buf, n);
+ *	printf("%016llx\n", (unsigned long long)hash64_fast_final(&st));
+ */
+struct hash64_fast_state {
+	uint64_t seed, see1, see2;
+	uint64_t total;
+	size_t pending;
+	/* 16 bytes of already hashed input, then up to 48 pending bytes. */
+	uint8_t buf[64];
+};
+
+void hash64_fast_init(struct hash64_fast_state *st, uint64_t base);
+void hash64_fast_update(struct hash64_fast_state *st, const void *data, size_t len);
+/* The state is left untouched, so more data may still be added.  */
+uint64_t hash64_fast_final(const struct hash64_fast_state *st);
+
+/**
+ * hash_string - very fast hash of a string
+ * @str: the nul-terminated string
+ *
+ * The string is hashed with hash64_fast_any(), folded into 32 bits.
+ *
+ * This hash may have different results on different machines, so is
+ * only useful for internal hashes (ie. not hashes sent across the
+ * network or saved to disk).  The results will be different from the
+ * other hash functions in this module, too.
+ */
+static inline uint32_t hash_string(const char *string)
+{
+	uint64_t h = hash64_fast_any(string, strlen(string), 0);
+
+	return h ^ (h >> 32);
+}
+
 /**
  * hash_pointer - hash a pointer for internal use
  * @p: the pointer value to hash
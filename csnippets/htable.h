@@ -18,6 +18,8 @@ struct htable {
 	uintptr_t common_mask, common_bits;
 	uintptr_t perfect_bit;
 	uintptr_t *table;
+	/* Only maintained when built with _DEBUG_HTABLE, see htable_stats().  */
+	unsigned long rehashes, doubles;
 };
 
 /**
@@ -170,4 +172,58 @@ void *htable_next(const struct htable *htable, struct htable_iter *i);
  */
 void htable_delval(struct htable *ht, struct htable_iter *i);
 
+/* Number of buckets in the probe length histogram of struct htable_stats.  */
+#define HTABLE_PROBE_HIST	16
+
+/**
+ * struct htable_stats - a snapshot of a hash table's internals
+ * @elems: number of entries
+ * @deleted: number of deleted markers left in the table
+ * @bits: log2 of the number of buckets
+ * @load: (elems + deleted) / buckets
+ * @common_bits: number of pointer bits stolen for the hash filter
+ * @perfect_bit: whether we still have a "perfect" bit (see update_common())
+ * @avg_probe: average distance of an entry from its home bucket
+ * @max_probe: longest distance of an entry from its home bucket
+ * @probe_hist: number of entries per probe distance, the last bucket
+ *		counts every distance >= HTABLE_PROBE_HIST - 1
+ * @rehashes: number of in-place rehashes (cleaning deleted markers)
+ * @doubles: number of times the table has grown
+ *
+ * @rehashes and @doubles are always 0 unless the library was built
+ * with _DEBUG_HTABLE.
+ *
+ * When pointers come from different arenas they share less high bits,
+ * @common_bits drops and htable_firstval() has to dereference more
+ * false candidates.  A growing @avg_probe usually means a weak hash.
+ */
+struct htable_stats {
+	size_t elems, deleted;
+	unsigned int bits;
+	double load;
+	unsigned int common_bits;
+	bool perfect_bit;
+	double avg_probe;
+	size_t max_probe;
+	size_t probe_hist[HTABLE_PROBE_HIST];
+	unsigned long rehashes, doubles;
+};
+
+/**
+ * htable_stats - gather statistics about a hash table
+ * @ht: the htable
+ * @st: where to store them
+ *
+ * This rehashes every entry to find its home bucket, so it's O(n); it's
+ * meant for diagnostics, not for hot paths.
+ *
+ * Example:
+ *	struct htable_stats st;
+ *
+ *	htable_stats(&ht, &st);
+ *	printf("%zu elems, load %.2f, avg probe %.2f, %u filter bits\n",
+ *	       st.elems, st.load, st.avg_probe, st.common_bits);
+ */
+void htable_stats(const struct htable *ht, struct htable_stats *st);
+
 #endif /* _HTABLE_H */
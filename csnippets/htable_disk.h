@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2013 Ahmed Samy  <f.fallen45@gmail.com>
+ * Licensed under MIT, see LICENSE.MIT for details.
+ */
+#ifndef _HTABLE_DISK_H
+#define _HTABLE_DISK_H
+
+/**
+ * Persistent, read-only hash tables that are used straight from a
+ * memory mapping, there's no parsing or rebuilding on load.
+ *
+ * The file layout is fixed and machine independent: every integer is
+ * stored little-endian, offsets are used instead of pointers and keys
+ * are hashed with hash64_stable_8(), so a file built on one machine can
+ * be used on any other.
+ *
+ *	header		64 bytes, see below
+ *	buckets		(1 << bits) * { u64 hash; u64 offset; }, offset 0 = empty
+ *	records		{ u32 klen; u32 vlen; key; value; } padded to 8 bytes
+ *
+ *	header:
+ *		char magic[8]	"CSHTABLE"
+ *		u32 version	HTABLE_DISK_VERSION
+ *		u32 bits	log2 of the number of buckets
+ *		u64 elems	number of records
+ *		u64 seed	base passed to hash64_stable_8()
+ *		u64 buckets	offset of the bucket array
+ *		u64 records	offset of the first record
+ *		u64 size	total size of the file
+ *		u64 reserved	0
+ *
+ * Keys and values are arbitrary byte strings; values are 8-byte aligned
+ * only if the key length is a multiple of 8.
+ */
+#define HTABLE_DISK_VERSION	1
+
+struct htable_disk;
+struct htable_disk_builder;
+
+/**
+ * htable_disk_open - map a table file
+ * @path: the file, written by htable_disk_builder_write()
+ *
+ * Returns NULL if the file couldn't be mapped or doesn't look like a
+ * table (wrong magic, version or truncated).
+ */
+extern struct htable_disk *htable_disk_open(const char *path);
+
+/**
+ * htable_disk_from_memory - use a table that is already in memory
+ * @mem: the table's bytes (8-byte aligned), must outlive the table
+ * @size: the size of @mem
+ *
+ * Useful for tables embedded in the binary or received otherwise.
+ */
+extern struct htable_disk *htable_disk_from_memory(const void *mem, size_t size);
+
+/* htable_disk_close - unmap the table and free its handle.  */
+extern void htable_disk_close(struct htable_disk *ht);
+
+/* htable_disk_count - number of records in the table.  */
+extern size_t htable_disk_count(const struct htable_disk *ht);
+
+/**
+ * htable_disk_get - find a record by key
+ * @ht: the table
+ * @key: the key bytes
+ * @klen: the length of @key
+ * @vlen: where to store the value's length (may be NULL)
+ *
+ * Returns a pointer to the value inside the mapping, or NULL if @key
+ * is not in the table.  The pointer is valid until htable_disk_close().
+ */
+extern const void *htable_disk_get(const struct htable_disk *ht,
+				   const void *key, size_t klen, size_t *vlen);
+
+/**
+ * htable_disk_next - iterate over every record
+ * @ht: the table
+ * @iter: iterator, set it to 0 before the first call
+ * @key, @klen: where to store the record's key
+ * @val, @vlen: where to store the record's value
+ *
+ * Returns false once there are no more records.
+ *
+ * Example:
+ *	size_t it = 0, klen, vlen;
+ *	const void *k, *v;
+ *
+ *	while (htable_disk_next(ht, &it, &k, &klen, &v, &vlen))
+ *		printf("%.*s\n", (int)klen, (const char *)k);
+ */
+extern bool htable_disk_next(const struct htable_disk *ht, size_t *iter,
+			     const void **key, size_t *klen,
+			     const void **val, size_t *vlen);
+
+/**
+ * htable_disk_builder_new - start building a table
+ * @seed: hash seed stored in the file (usually 0)
+ */
+extern struct htable_disk_builder *htable_disk_builder_new(uint64_t seed);
+
+/**
+ * htable_disk_builder_add - add a record to the table being built
+ *
+ * Key and value are copied.  Keys should be unique, if a key is added
+ * twice, htable_disk_get() returns the first one.
+ *
+ * Returns false on allocation failure.
+ */
+extern bool htable_disk_builder_add(struct htable_disk_builder *b,
+				    const void *key, size_t klen,
+				    const void *val, size_t vlen);
+
+/**
+ * htable_disk_builder_write - write the table to @path
+ *
+ * The table is written to a temporary file which is then renamed, so
+ * readers never see a half-written table.
+ *
+ * Returns false on failure, see errno.
+ */
+extern bool htable_disk_builder_write(struct htable_disk_builder *b,
+				      const char *path);
+
+/* htable_disk_builder_free - free the builder and its records.  */
+extern void htable_disk_builder_free(struct htable_disk_builder *b);
+
+#endif /* _HTABLE_DISK_H */
@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2013 Ahmed Samy  <f.fallen45@gmail.com>
+ * Licensed under MIT, see LICENSE.MIT for details.
+ */
+#ifndef _HTABLE_FLAT_H
+#define _HTABLE_FLAT_H
+
+/**
+ * Flat (open addressing) hash maps whose keys and values are stored
+ * inline in the slot array.
+ *
+ * struct htable (see htable.h) only stores pointers, so every lookup has
+ * to dereference the candidate element to compare keys.  For small keys
+ * (file descriptors, ids, ...) it's a lot cheaper to keep the key next to
+ * its value and compare it in place.
+ *
+ * Each slot has a control byte kept in a separate array:
+ *	0x00		- empty slot
+ *	0x01		- deleted slot (tombstone)
+ *	0x80 | tag	- used slot, tag is 7 bits of the hash
+ * so most mismatches are rejected without touching the slot at all.
+ */
+#define HTABLE_FLAT_EMPTY	0x00
+#define HTABLE_FLAT_DELETED	0x01
+
+/* Initial number of slots, must be a power of 2.  */
+#define HTABLE_FLAT_MIN_SIZE	8
+
+/**
+ * HTABLE_FLAT_INITIALIZER - static initialization for a flat hash table.
+ *
+ * Example:
+ *	static struct conn_map conns = HTABLE_FLAT_INITIALIZER;
+ */
+#define HTABLE_FLAT_INITIALIZER	{ 0, 0, 0, NULL, NULL }
+
+static inline uint8_t htable_flat_tag(size_t hash)
+{
+	/* The low bits select the bucket, take the tag from higher ones
+	 * which are still present in 32-bit hashes.  */
+	return 0x80 | ((hash >> 25) & 0x7f);
+}
+
+/**
+ * HTABLE_DEFINE_FLAT_TYPE - create a set of flat hash map ops for a key type
+ * @ktype: the key type, stored by value (keep it small)
+ * @vtype: the value type, stored by value (keep it small)
+ * @hashfn: a hash function for a key: size_t @hashfn(ktype)
+ * @eqfn: an equality function for keys: bool @eqfn(ktype, ktype)
+ * @name: a prefix for all the functions to define (of form <name>_*)
+ *
+ * Everything is defined as static inline, so @hashfn and @eqfn are
+ * inlined in the lookup loop.
+ *
+ * This defines the map type, a slot type and an iterator type:
+ *	struct <name>;
+ *	struct <name>_slot { ktype key; vtype val; };
+ *	struct <name>_iter;
+ *
+ * Initialization and freeing functions:
+ *	void <name>_init(struct <name> *);
+ *	void <name>_clear(struct <name> *);
+ *
+ * Add (or replace the value of an existing key), only fails if we run
+ * out of memory:
+ *	bool <name>_add(struct <name> *ht, ktype key, vtype val);
+ *
+ * Delete returns true if the key was in the map:
+ *	bool <name>_del(struct <name> *ht, ktype key);
+ *
+ * Find functions return a pointer inside the table, or NULL.  The
+ * pointer is only valid until the next call to <name>_add():
+ *	vtype *<name>_get(const struct <name> *ht, ktype key);
+ *	struct <name>_slot *<name>_find(const struct <name> *ht, ktype key);
+ *
+ * Iteration over the table is also supported, deleting the current slot
+ * with <name>_delslot() while iterating is fine:
+ *	struct <name>_slot *<name>_first(const struct <name> *ht, struct <name>_iter *i);
+ *	struct <name>_slot *<name>_next(const struct <name> *ht, struct <name>_iter *i);
+ *	void <name>_delslot(struct <name> *ht, struct <name>_slot *s);
+ *
+ * Example:
+ *	static size_t fd_hash(int fd)
+ *	{
+ *		return hash_u32((uint32_t *)&fd, 1, 0);
+ *	}
+ *	static bool fd_eq(int a, int b)
+ *	{
+ *		return a == b;
+ *	}
+ *	HTABLE_DEFINE_FLAT_TYPE(int, conn_t *, fd_hash, fd_eq, conn_map);
+ *
+ *	static struct conn_map conns = HTABLE_FLAT_INITIALIZER;
+ */
+#define HTABLE_DEFINE_FLAT_TYPE(ktype, vtype, hashfn, eqfn, name)	\
+	struct name##_slot { ktype key; vtype val; };			\
+	struct name {							\
+		size_t elems, deleted, mask;				\
+		struct name##_slot *slots;				\
+		uint8_t *ctrl;						\
+	};								\
+	struct name##_iter { size_t off; };				\
+	static inline void name##_init(struct name *ht)		\
+	{								\
+		struct name empty = HTABLE_FLAT_INITIALIZER;		\
+		*ht = empty;						\
+	}								\
+	static inline void name##_clear(struct name *ht)		\
+	{								\
+		free(ht->slots);					\
+		name##_init(ht);					\
+	}								\
+	static inline struct name##_slot *				\
+	name##_findh(const struct name *ht, ktype key, size_t h)	\
+	{								\
+		uint8_t tag = htable_flat_tag(h);			\
+		size_t i;						\
+									\
+		if (!ht->slots)						\
+			return NULL;					\
+		for (i = h & ht->mask; ht->ctrl[i] != HTABLE_FLAT_EMPTY; \
+		     i = (i + 1) & ht->mask)				\
+			if (ht->ctrl[i] == tag && eqfn(ht->slots[i].key, key)) \
+				return &ht->slots[i];			\
+		return NULL;						\
+	}								\
+	static inline struct name##_slot *				\
+	name##_find(const struct name *ht, ktype key)			\
+	{								\
+		return name##_findh(ht, key, hashfn(key));		\
+	}								\
+	static inline vtype *name##_get(const struct name *ht, ktype key) \
+	{								\
+		struct name##_slot *s = name##_find(ht, key);		\
+		return s ? &s->val : NULL;				\
+	}								\
+	static inline void name##_put(struct name *ht, ktype key,	\
+				      vtype val, size_t h)		\
+	{								\
+		size_t i;						\
+									\
+		for (i = h & ht->mask; ht->ctrl[i] > HTABLE_FLAT_DELETED; \
+		     i = (i + 1) & ht->mask);				\
+		if (ht->ctrl[i] == HTABLE_FLAT_DELETED)			\
+			ht->deleted--;					\
+		ht->ctrl[i] = htable_flat_tag(h);			\
+		ht->slots[i].key = key;					\
+		ht->slots[i].val = val;					\
+	}								\
+	static inline __cold bool					\
+	name##_resize(struct name *ht, size_t size)			\
+	{								\
+		struct name old = *ht;					\
+		size_t i;						\
+									\
+		ht->slots = calloc(size, sizeof(struct name##_slot) + 1); \
+		if (!ht->slots) {					\
+			*ht = old;					\
+			return false;					\
+		}							\
+		ht->ctrl = (uint8_t *)(ht->slots + size);		\
+		ht->mask = size - 1;					\
+		ht->deleted = 0;					\
+		for (i = 0; old.slots && i <= old.mask; i++)		\
+			if (old.ctrl[i] > HTABLE_FLAT_DELETED)		\
+				name##_put(ht, old.slots[i].key,	\
+					   old.slots[i].val,		\
+					   hashfn(old.slots[i].key));	\
+		free(old.slots);					\
+		return true;						\
+	}								\
+	static inline bool name##_add(struct name *ht, ktype key, vtype val) \
+	{								\
+		size_t h = hashfn(key), size = ht->mask + 1;		\
+		struct name##_slot *s = name##_findh(ht, key, h);	\
+									\
+		if (s) {						\
+			s->val = val;					\
+			return true;					\
+		}							\
+		if (!ht->slots) {					\
+			if (!name##_resize(ht, HTABLE_FLAT_MIN_SIZE))	\
+				return false;				\
+		} else if ((ht->elems + 1) * 4 > size * 3) {		\
+			if (!name##_resize(ht, size * 2))		\
+				return false;				\
+		} else if ((ht->elems + ht->deleted + 1) * 10 > size * 9) { \
+			/* Too many tombstones, rehash in place.  */	\
+			if (!name##_resize(ht, size))			\
+				return false;				\
+		}							\
+		name##_put(ht, key, val, h);				\
+		ht->elems++;						\
+		return true;						\
+	}								\
+	static inline void name##_delslot(struct name *ht,		\
+					  struct name##_slot *s)	\
+	{								\
+		size_t i = s - ht->slots;				\
+									\
+		assert(i <= ht->mask);					\
+		assert(ht->ctrl[i] > HTABLE_FLAT_DELETED);		\
+		/* If the next slot is empty no probe sequence goes	\
+		 * through this one, so we don't need a tombstone.  */	\
+		if (ht->ctrl[(i + 1) & ht->mask] == HTABLE_FLAT_EMPTY)	\
+			ht->ctrl[i] = HTABLE_FLAT_EMPTY;		\
+		else {							\
+			ht->ctrl[i] = HTABLE_FLAT_DELETED;		\
+			ht->deleted++;					\
+		}							\
+		ht->elems--;						\
+	}								\
+	static inline bool name##_del(struct name *ht, ktype key)	\
+	{								\
+		struct name##_slot *s = name##_find(ht, key);		\
+									\
+		if (!s)							\
+			return false;					\
+		name##_delslot(ht, s);					\
+		return true;						\
+	}								\
+	static inline struct name##_slot *				\
+	name##_next(const struct name *ht, struct name##_iter *iter)	\
+	{								\
+		for (iter->off++; ht->slots && iter->off <= ht->mask; iter->off++) \
+			if (ht->ctrl[iter->off] > HTABLE_FLAT_DELETED)	\
+				return &ht->slots[iter->off];		\
+		return NULL;						\
+	}								\
+	static inline struct name##_slot *				\
+	name##_first(const struct name *ht, struct name##_iter *iter)	\
+	{								\
+		iter->off = (size_t)-1;					\
+		return name##_next(ht, iter);				\
+	}
+
+#endif /* _HTABLE_FLAT_H */
@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2013 Ahmed Samy  <f.fallen45@gmail.com>
+ * Licensed under MIT, see LICENSE.MIT for details.
+ */
+#ifndef _IRBTREE_H
+#define _IRBTREE_H
+
+#include <csnippets/container_of.h>
+
+_BEGIN_DECLS
+
+/**
+ * Intrusive red-black trees.
+ *
+ * Unlike rb_tree (see rbtree.h), the tree doesn't allocate nodes nor
+ * store key pointers: a struct irb_node is embedded in your own structure
+ * (just like a struct list_node) and the search is written by the caller
+ * (or generated by IRBTREE_DEFINE_TYPE), so the comparison is inlined.
+ * Only the rebalancing is out of line.
+ *
+ * The node's color lives in the low bit of its parent pointer, so a node
+ * is 3 words.
+ */
+struct irb_node {
+	uintptr_t parent_color;
+	struct irb_node *left;
+	struct irb_node *right;
+};
+
+/**
+ * struct irb_root - the root of an intrusive red-black tree
+ * @node: the root node, NULL if the tree is empty
+ *
+ * Example:
+ *	struct timer {
+ *		uint64_t expires;
+ *		struct irb_node node;
+ *	};
+ *	static struct irb_root timers = IRB_ROOT_INITIALIZER;
+ */
+struct irb_root {
+	struct irb_node *node;
+};
+
+#define IRB_ROOT_INITIALIZER	{ NULL }
+
+#define IRB_RED		0
+#define IRB_BLACK	1
+
+/**
+ * irb_entry - get the structure containing a node
+ * @n: the struct irb_node
+ * @type: the type of the entry
+ * @member: the irb_node member of the type
+ */
+#define irb_entry(n, type, member) container_of(n, type, member)
+
+static inline struct irb_node *irb_parent(const struct irb_node *n)
+{
+	return (struct irb_node *)(n->parent_color & ~(uintptr_t)3);
+}
+
+static inline bool irb_empty(const struct irb_root *root)
+{
+	return root->node == NULL;
+}
+
+/**
+ * irb_link_node - put a new node at the spot found by a search
+ * @n: the new node
+ * @parent: the last node visited by the search (NULL for an empty tree)
+ * @link: the NULL child pointer of @parent (or &root->node) to attach to
+ *
+ * Must be followed by irb_insert_color() to rebalance the tree.
+ *
+ * Example:
+ *	static void timer_add(struct irb_root *root, struct timer *t)
+ *	{
+ *		struct irb_node **link = &root->node, *parent = NULL;
+ *
+ *		while (*link) {
+ *			parent = *link;
+ *			if (t->expires < irb_entry(parent, struct timer, node)->expires)
+ *				link = &parent->left;
+ *			else
+ *				link = &parent->right;
+ *		}
+ *
+ *		irb_link_node(&t->node, parent, link);
+ *		irb_insert_color(&t->node, root);
+ *	}
+ */
+static inline void irb_link_node(struct irb_node *n, struct irb_node *parent,
+				 struct irb_node **link)
+{
+	n->parent_color = (uintptr_t)parent;	/* red */
+	n->left = n->right = NULL;
+	*link = n;
+}
+
+/* irb_insert_color - rebalance after irb_link_node().  */
+extern void irb_insert_color(struct irb_node *n, struct irb_root *root);
+/* irb_erase - unlink @n from the tree, @n may be reused afterwards.  */
+extern void irb_erase(struct irb_node *n, struct irb_root *root);
+
+/* In-order traversal, NULL when there's no such node.  */
+extern struct irb_node *irb_first(const struct irb_root *root);
+extern struct irb_node *irb_last(const struct irb_root *root);
+extern struct irb_node *irb_next(const struct irb_node *n);
+extern struct irb_node *irb_prev(const struct irb_node *n);
+
+/**
+ * IRBTREE_DEFINE_TYPE - create a set of typed tree ops for a type
+ * @type: the type of the entries
+ * @member: the struct irb_node member of @type
+ * @ktype: the key type
+ * @keyof: a function/macro to extract a key: <ktype> @keyof(const type *elem)
+ * @cmpfn: a comparison of keys: int @cmpfn(<ktype>, <ktype>), < 0, 0 or > 0
+ * @name: a prefix for all the functions to define (of form <name>_*)
+ *
+ * Everything is static inline, so @keyof and @cmpfn are inlined in the
+ * searches.  Nothing is allocated: adding an entry only links the node
+ * embedded in it.
+ *
+ * This defines the tree type:
+ *	struct <name>;
+ *
+ * Initialization:
+ *	void <name>_init(struct <name> *);
+ *
+ * Add and delete (entries with equal keys are kept in insertion order):
+ *	void <name>_add(struct <name> *t, type *e);
+ *	void <name>_del(struct <name> *t, type *e);
+ *
+ * Searches return the entry or NULL:
+ *	type *<name>_get(const struct <name> *t, ktype k);		== k
+ *	type *<name>_lower_bound(const struct <name> *t, ktype k);	first >= k
+ *	type *<name>_upper_bound(const struct <name> *t, ktype k);	first > k
+ *
+ * In-order iteration:
+ *	type *<name>_first(const struct <name> *t);
+ *	type *<name>_last(const struct <name> *t);
+ *	type *<name>_next(const type *e);
+ *	type *<name>_prev(const type *e);
+ *
+ * Example:
+ *	static inline uint64_t timer_key(const struct timer *t)
+ *	{
+ *		return t->expires;
+ *	}
+ *	static inline int u64_cmp(uint64_t a, uint64_t b)
+ *	{
+ *		return a < b ? -1 : a > b;
+ *	}
+ *	IRBTREE_DEFINE_TYPE(struct timer, node, uint64_t, timer_key, u64_cmp, timer_tree);
+ *
+ *	// Run every timer that expired.
+ *	while ((t = timer_tree_first(&timers)) && t->expires <= now) {
+ *		timer_tree_del(&timers, t);
+ *		run_timer(t);
+ *	}
+ */
+#define IRBTREE_DEFINE_TYPE(type, member, ktype, keyof, cmpfn, name)	\
+	struct name { struct irb_root root; };				\
+	static inline void name##_init(struct name *t)			\
+	{								\
+		t->root.node = NULL;					\
+	}								\
+	static inline type *name##_entry(const struct irb_node *n)	\
+	{								\
+		return n ? irb_entry(n, type, member) : NULL;		\
+	}								\
+	static inline void name##_add(struct name *t, type *e)		\
+	{								\
+		struct irb_node **link = &t->root.node, *parent = NULL;	\
+		ktype k = keyof(e);					\
+									\
+		while (*link) {						\
+			parent = *link;					\
+			if (cmpfn(k, keyof(name##_entry(parent))) < 0)	\
+				link = &parent->left;			\
+			else						\
+				link = &parent->right;			\
+		}							\
+		irb_link_node(&e->member, parent, link);		\
+		irb_insert_color(&e->member, &t->root);			\
+	}								\
+	static inline void name##_del(struct name *t, type *e)		\
+	{								\
+		irb_erase(&e->member, &t->root);			\
+	}								\
+	static inline type *name##_get(const struct name *t, ktype k)	\
+	{								\
+		struct irb_node *n = t->root.node;			\
+									\
+		while (n) {						\
+			int c = cmpfn(k, keyof(name##_entry(n)));	\
+			if (c == 0)					\
+				return name##_entry(n);			\
+			n = c < 0 ? n->left : n->right;			\
+		}							\
+		return NULL;						\
+	}								\
+	static inline type *name##_lower_bound(const struct name *t, ktype k) \
+	{								\
+		struct irb_node *n = t->root.node, *best = NULL;	\
+									\
+		while (n) {						\
+			if (cmpfn(keyof(name##_entry(n)), k) >= 0) {	\
+				best = n;				\
+				n = n->left;				\
+			} else						\
+				n = n->right;				\
+		}							\
+		return name##_entry(best);				\
+	}								\
+	static inline type *name##_upper_bound(const struct name *t, ktype k) \
+	{								\
+		struct irb_node *n = t->root.node, *best = NULL;	\
+									\
+		while (n) {						\
+			if (cmpfn(keyof(name##_entry(n)), k) > 0) {	\
+				best = n;				\
+				n = n->left;				\
+			} else						\
+				n = n->right;				\
+		}							\
+		return name##_entry(best);				\
+	}								\
+	static inline type *name##_first(const struct name *t)		\
+	{								\
+		return name##_entry(irb_first(&t->root));		\
+	}								\
+	static inline type *name##_last(const struct name *t)		\
+	{								\
+		return name##_entry(irb_last(&t->root));		\
+	}								\
+	static inline type *name##_next(const type *e)			\
+	{								\
+		return name##_entry(irb_next(&e->member));		\
+	}								\
+	static inline type *name##_prev(const type *e)			\
+	{								\
+		return name##_entry(irb_prev(&e->member));		\
+	}
+
+_END_DECLS
+
+#endif /* _IRBTREE_H */
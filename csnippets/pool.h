@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2013 Ahmed Samy  <f.fallen45@gmail.com>
+ * Licensed under MIT, see LICENSE.MIT for details.
+ */
+#ifndef _POOL_H
+#define _POOL_H
+
+#include <pthread.h>
+
+/**
+ * Fixed-size object pools.
+ *
+ * Freed objects go on a free list (the link is stored in the object
+ * itself) instead of back to malloc, and an empty pool is refilled with
+ * POOL_BATCH objects carved out of one malloc() call.  Memory taken by a
+ * pool is never given back to the system, it's reused for objects of the
+ * same type.
+ *
+ * POOL_DEFINE_TYPE() gives a pool shared by all threads, protected by a
+ * mutex.  POOL_DEFINE_CACHED_TYPE() adds a per-thread cache in front of
+ * it: allocating and freeing only touch the cache, which is refilled from
+ * (or released to) the shared pool POOL_BATCH objects at a time, so the
+ * mutex is taken once per batch.  Objects may be freed by another thread
+ * than the one that allocated them.
+ */
+#define POOL_BATCH	64
+
+struct pool_free {
+	struct pool_free *next;
+};
+
+struct pool {
+	pthread_mutex_t lock;
+	struct pool_free *free;
+	size_t size;		/* of an object */
+};
+
+struct pool_cache {
+	struct pool_free *head;
+	size_t count;
+
+	/* Set on first use, so that the cache is given back to @pool when
+	 * the thread exits.  */
+	struct pool *pool;
+	struct pool_cache *next;
+};
+
+#define POOL_INITIALIZER(type)	{					\
+	PTHREAD_MUTEX_INITIALIZER, NULL,				\
+	sizeof(type) < sizeof(struct pool_free)				\
+		? sizeof(struct pool_free) : sizeof(type)		\
+}
+
+extern void *pool_get(struct pool *p);
+extern void pool_put(struct pool *p, void *obj);
+/* Move POOL_BATCH objects to @c, false if we ran out of memory.  */
+extern bool pool_refill(struct pool *p, struct pool_cache *c);
+/* Move @n objects from @c back to @p.  */
+extern void pool_release(struct pool *p, struct pool_cache *c, size_t n);
+/* Have @c given back to @p when the thread exits, done on first use.  */
+extern __cold void pool_cache_register(struct pool *p, struct pool_cache *c);
+
+/**
+ * POOL_DEFINE_TYPE - create a pool of @type objects
+ * @type: the object type
+ * @name: a prefix for all the functions to define (of form <name>_*)
+ *
+ * This defines:
+ *	type *<name>_alloc(void);	(uninitialized, NULL on failure)
+ *	type *<name>_zalloc(void);	(zeroed)
+ *	void <name>_free(type *);
+ *
+ * Example:
+ *	POOL_DEFINE_TYPE(struct foo, foo);
+ *
+ *	struct foo *f = foo_zalloc();
+ *	...
+ *	foo_free(f);
+ */
+#define POOL_DEFINE_TYPE(type, name)					\
+	static struct pool name##_pool = POOL_INITIALIZER(type);	\
+	static inline type *name##_alloc(void)				\
+	{								\
+		return pool_get(&name##_pool);				\
+	}								\
+	static inline void name##_free(type *obj)			\
+	{								\
+		pool_put(&name##_pool, obj);				\
+	}								\
+	__POOL_DEFINE_ZALLOC(type, name)
+
+/**
+ * POOL_DEFINE_CACHED_TYPE - same as POOL_DEFINE_TYPE() with a per-thread
+ * cache, the cache is given back to the shared pool when the thread exits.
+ */
+#define POOL_DEFINE_CACHED_TYPE(type, name)				\
+	static struct pool name##_pool = POOL_INITIALIZER(type);	\
+	static __thread struct pool_cache name##_cache;			\
+	static inline type *name##_alloc(void)				\
+	{								\
+		struct pool_cache *c = &name##_cache;			\
+		struct pool_free *obj;					\
+									\
+		if (unlikely(!c->head) && !pool_refill(&name##_pool, c)) \
+			return NULL;					\
+		obj = c->head;						\
+		c->head = obj->next;					\
+		c->count--;						\
+		return (type *)obj;					\
+	}								\
+	static inline void name##_free(type *p)			\
+	{								\
+		struct pool_cache *c = &name##_cache;			\
+		struct pool_free *obj = (struct pool_free *)p;		\
+									\
+		if (!obj)						\
+			return;						\
+		/* The thread may only ever free, it still needs to	\
+		 * give its cache back.  */				\
+		if (unlikely(!c->pool))					\
+			pool_cache_register(&name##_pool, c);		\
+		obj->next = c->head;					\
+		c->head = obj;						\
+		if (unlikely(++c->count > 2 * POOL_BATCH))		\
+			pool_release(&name##_pool, c, POOL_BATCH);	\
+	}								\
+	__POOL_DEFINE_ZALLOC(type, name)
+
+#define __POOL_DEFINE_ZALLOC(type, name)				\
+	static inline __unused type *name##_zalloc(void)		\
+	{								\
+		type *obj = name##_alloc();				\
+									\
+		if (obj)						\
+			memset(obj, 0, sizeof(type));			\
+		return obj;						\
+	}
+
+#endif /* _POOL_H */
@@ -32,15 +32,26 @@ typedef struct rb_node {
 	void *key;
 	void *info;
 	bool red;
+	bool slab;	/* allocated by rbtree_build_sorted() */
+	size_t size;	/* nodes in this subtree, see rbtree_augment() */
 
 	struct rb_node *left;
 	struct rb_node *right;
 	struct rb_node *parent;
 } rb_node;
 
+/* Nodes allocated at once by rbtree_build_sorted().  */
+struct rb_slab {
+	struct rb_slab *next;
+	rb_node nodes[];
+};
+
 typedef struct rb_tree {
 	rb_node *root;
 	rb_node *null;
+	bool augmented;
+	struct rb_slab *slabs;
+	size_t heap_nodes;	/* nodes not in a slab */
 
 	int (*compare) (const void *, const void *);
 	void (*destroy_key) (void *);
@@ -58,6 +69,17 @@ extern rb_tree *rbtree_create(int (*compare) (const void *, const void *),
 extern void rbtree_destroy(rb_tree *);
 
 extern rb_node *rbtree_insert(rb_tree *, void *key, void *info);
+/**
+ * rbtree_build_sorted - fill an empty tree from sorted arrays
+ * @keys: @n keys, sorted according to the tree's compare function
+ * @infos: @n infos to go with them, or NULL
+ *
+ * Builds a balanced tree in O(n) with a single allocation for all the
+ * nodes, there's no rebalancing at all.  The tree may be modified
+ * normally afterwards.  Returns false if the tree isn't empty or we ran
+ * out of memory.
+ */
+extern bool rbtree_build_sorted(rb_tree *, void **keys, void **infos, size_t n);
 extern void rbtree_remove(rb_tree *, rb_node *);
 extern rb_node *rbtree_query(rb_tree *tree, void *query);
 
@@ -66,5 +88,62 @@ extern rb_node *rbtree_predecessor(rb_tree *, rb_node *);
 
 extern void rbtree_print(rb_tree *);
 
+/*
+ * Ordered access, these return NULL (not tree->null) when there's no
+ * such node.
+ */
+extern rb_node *rbtree_first(rb_tree *);
+extern rb_node *rbtree_last(rb_tree *);
+/* The first node whose key is >= @key.  */
+extern rb_node *rbtree_lower_bound(rb_tree *, const void *key);
+/* The first node whose key is > @key.  */
+extern rb_node *rbtree_upper_bound(rb_tree *, const void *key);
+
+/**
+ * rb_iter - iterate over the nodes with keys in [lo, hi)
+ *
+ * Only the first node is searched from the root, the following ones are
+ * reached with rbtree_successor(), so visiting k nodes is O(log n + k).
+ * Don't remove the current node while iterating.
+ *
+ * Example:
+ *	rb_iter it;
+ *	rb_node *n;
+ *
+ *	rbtree_for_each_range(tree, it, n, &from, &to)
+ *		handle_sample(n->info);
+ */
+typedef struct rb_iter {
+	rb_tree *tree;
+	rb_node *node;
+	const void *hi;
+} rb_iter;
+
+extern rb_node *rbtree_range_first(rb_tree *, rb_iter *,
+				   const void *lo, const void *hi);
+extern rb_node *rbtree_range_next(rb_iter *);
+
+#define rbtree_for_each_range(tree, it, n, lo, hi)		\
+	for (n = rbtree_range_first(tree, &(it), lo, hi); n;	\
+	     n = rbtree_range_next(&(it)))
+
+/**
+ * rbtree_augment - maintain subtree sizes for rank and select
+ *
+ * Once called (it's O(n) on a tree that isn't empty), every node's size
+ * is kept up to date by inserts, removals and rotations, which costs one
+ * more write per level.  Trees that don't call this pay nothing.
+ *
+ * Example:
+ *	// The 99th percentile of the latency samples.
+ *	rbtree_augment(samples);
+ *	n = rbtree_select(samples, count * 99 / 100);
+ */
+extern void rbtree_augment(rb_tree *);
+/* Number of nodes before @node in order (0 for the first one).  */
+extern size_t rbtree_rank(rb_tree *, rb_node *node);
+/* The node of rank @k, NULL if there are not that many nodes.  */
+extern rb_node *rbtree_select(rb_tree *, size_t k);
+
 #endif
 
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2013 Ahmed Samy  <f.fallen45@gmail.com>
+ * Licensed under MIT, see LICENSE.MIT for details.
+ */
+#ifndef _ROPE_H
+#define _ROPE_H
+
+#include <csnippets/list.h>
+
+#ifdef _WIN32
+struct iovec {
+	void *iov_base;
+	size_t iov_len;
+};
+#else
+#include <sys/uio.h>
+#endif
+
+/**
+ * Ropes, segmented buffers.
+ *
+ * A rope is a list of fixed-size chunks.  Appending fills the last chunk
+ * and adds new ones as needed, prepending does the same at the front, so
+ * bytes already in the rope are never moved or copied again however big it
+ * gets, unlike buffer_t which reallocates.
+ *
+ * The contents are read with a cursor (rope_read()) or handed to writev()
+ * as an iovec array (rope_iovec()), see also conn_write_rope() in
+ * socket.h.
+ *
+ * Example:
+ *	rope_t *r = rope_new();
+ *
+ *	rope_append(r, body, body_len);
+ *	sprintf(hdr, "Content-Length: %zu\r\n\r\n", rope_len(r));
+ *	rope_prepend(r, hdr, strlen(hdr));
+ *	...
+ *	rope_free(r);
+ */
+#define ROPE_CHUNK_SIZE	(16 * 1024 - 64)	/* data bytes per chunk */
+
+struct rope_chunk {
+	struct list_node node;
+	size_t start, end;	/* data[start, end) is used */
+	uint8_t data[ROPE_CHUNK_SIZE];
+};
+
+typedef struct rope {
+	struct list_head chunks;
+	size_t len;
+} rope_t;
+
+/* A read position in a rope, see rope_read().  */
+typedef struct rope_cursor {
+	const rope_t *rope;
+	struct rope_chunk *chunk;	/* NULL at the end */
+	size_t pos;			/* in chunk->data */
+} rope_cursor_t;
+
+/* Returns NULL if we ran out of memory.  */
+extern rope_t *rope_new(void);
+extern void rope_free(rope_t *r);
+
+static inline size_t rope_len(const rope_t *r)
+{
+	return r->len;
+}
+
+/* rope_append(r, data, len) - Add @len bytes of @data at the end.
+ * Returns false if we ran out of memory, @r is left unchanged then.  */
+extern bool rope_append(rope_t *r, const void *data, size_t len);
+/* rope_prepend(r, data, len) - Add @len bytes of @data at the start.  */
+extern bool rope_prepend(rope_t *r, const void *data, size_t len);
+
+/* rope_consume(r, len) - Drop the first @len bytes (e.g. once they were
+ * sent), chunks that become empty are freed.  */
+extern void rope_consume(rope_t *r, size_t len);
+
+/**
+ * rope_iovec - describe the first @max segments of @r in @iov
+ *
+ * Returns the number of iovecs filled, which together hold the start of
+ * the rope (all of it if there are no more than @max chunks).
+ *
+ * Example:
+ *	struct iovec iov[16];
+ *	ssize_t n = writev(fd, iov, rope_iovec(r, iov, 16));
+ *	if (n > 0)
+ *		rope_consume(r, n);
+ */
+extern int rope_iovec(const rope_t *r, struct iovec *iov, int max);
+
+/* Start reading at the beginning of @r, the cursor is valid until the
+ * rope is modified.  */
+extern void rope_cursor_init(rope_cursor_t *c, const rope_t *r);
+/* Copy up to @len bytes to @out, returns the number of bytes copied
+ * (less than @len at the end of the rope).  */
+extern size_t rope_read(rope_cursor_t *c, void *out, size_t len);
+/* Same as rope_read() without copying.  */
+extern size_t rope_skip(rope_cursor_t *c, size_t len);
+
+#endif /* _ROPE_H */
@@ -11,6 +11,8 @@
 #define _SOCKET_H
 
 #include <csnippets/typesafe_cb.h>
+#include <csnippets/buffer.h>
+#include <csnippets/rope.h>
 
 /* Forward declare conn, internal usage only.  */
 typedef struct conn conn_t;
@@ -52,10 +54,34 @@ conn_t *_new_conn_fd(int fd,
 bool free_conn(conn_t *);
 
 bool conn_read(conn_t *conn, void *data, size_t *len);
+/* Write @data, what the socket doesn't take now is copied to the write
+ * queue and sent when it's writable again.  Returns false if the
+ * connection is broken.  */
 bool conn_write(conn_t *conn, const void *data, size_t len);
 bool conn_writestr(conn_t *conn, const char *fmt, ...)
 	__printf(2, 3);
 
+/* Read up to *@len bytes at the end of @b (after wpos), which grows as
+ * needed.  *@len is set to the number of bytes read.  */
+bool conn_read_buffer(conn_t *conn, buffer_t *b, size_t *len);
+
+/* Send the unread part of @b (rpos to wpos) without copying it: @b
+ * belongs to the connection now, and is queued as is if the socket
+ * can't take all of it.  It's bfree()'d once sent, or on failure.
+ *
+ * Example:
+ *	buffer_t *b = balloc(64);
+ *	badd32(b, MSG_HELLO);
+ *	baddbytes(b, name, len);
+ *	if (!conn_write_buffer(conn, b))
+ *		return false;
+ */
+bool conn_write_buffer(conn_t *conn, buffer_t *b);
+
+/* Same as conn_write_buffer() for a rope (see rope.h), which is sent
+ * with writev() straight from its chunks and rope_free()'d.  */
+bool conn_write_rope(conn_t *conn, rope_t *r);
+
 /* Calls @next at next acitivty from the connnection,
  * if the next function returns false, the connection is
  * free'd and is no longer valid for use.
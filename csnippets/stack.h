@@ -19,10 +19,14 @@
  *
  * 'ptr' is dynamicly allocated of course depending on the size
  * needed, see stack_push().
+ *
+ * For a plain growable array (or a table of reusable slots) see vector.h.
  */
 typedef struct stack {
 	void **ptr;     /* the internel array */
-	size_t size;
+	size_t size;	/* allocated slots */
+	size_t len;	/* 1 + the highest slot that may be used */
+	size_t hint;	/* every slot below this one is used */
 } stack_t;
 
 #define INITIAL_SIZE 10
@@ -77,9 +81,9 @@ extern bool stack_grow(stack_t *s, int newSize);
 extern int stack_push(stack_t *s, void *ptr, int where, void (*constructor) (void *));
 
 /**
- * Pop an item from the top stack.
+ * Pop an item from the top stack, its slot becomes empty.
  *
- * The user must free the pointer himself (and null terminate if possible).
+ * The user must free the pointer himself.
  *
  * \sa stack_top()
  */
@@ -34,18 +34,108 @@ char *strtrim(char *str);
  *	int size;
  *	char **splited = strexplode(str, ',', &size);
  * \endcode
+ *
+ * The array and each token are malloc'd, the array is NULL terminated.
+ * Returns NULL if we ran out of memory.
  */
 char **strexplode(char *string, char seperator, int *size);
 
-/** Wildcard string matching.
+/** Same as strexplode() but everything (the array and the tokens) is
+ * allocated from arena @a, so there's nothing to free one by one.
+ * Returns NULL if we ran out of memory.  */
+struct arena;
+char **strexplode_arena(struct arena *a, const char *string, char seperator,
+			int *size);
+
+/**
+ * Splitting without allocating.
+ *
+ * strsplit_next() returns the tokens one at a time as views into the
+ * string (pointer and length, not NUL terminated), the string isn't
+ * touched.  Like strexplode(), n separators give n + 1 tokens, empty ones
+ * included.
+ *
+ * Example:
+ * \code
+ *	strsplit_t s;
+ *	const char *tok;
+ *	size_t len;
+ *
+ *	strsplit_init(&s, line, strlen(line), ',');
+ *	while (strsplit_next(&s, &tok, &len))
+ *		printf("%.*s\n", (int)len, tok);
+ * \endcode
+ */
+typedef struct strsplit {
+	const char *pos;	/* NULL once the last token was returned */
+	const char *end;
+	char sep;
+} strsplit_t;
+
+static inline void strsplit_init(strsplit_t *s, const char *str, size_t len,
+				 char sep)
+{
+	s->pos = str;
+	s->end = str + len;
+	s->sep = sep;
+}
+
+static inline bool strsplit_next(strsplit_t *s, const char **tok, size_t *len)
+{
+	const char *p;
+
+	if (!s->pos)
+		return false;
+
+	p = memchr(s->pos, s->sep, s->end - s->pos);
+	*tok = s->pos;
+	if (p) {
+		*len = p - s->pos;
+		s->pos = p + 1;
+	} else {
+		*len = s->end - s->pos;
+		s->pos = NULL;
+	}
+	return true;
+}
+
+/** In-place splitting: cut the token at *@str with a NUL where @sep
+ * was, and advance *@str past it.  Returns NULL when there are no more
+ * tokens (*@str is set to NULL after the last one, like strsep()).
+ *
+ * Example:
+ * \code
+ *	char *p = line, *tok;
+ *
+ *	while ((tok = strcut(&p, ':')))
+ *		...
+ * \endcode
+ */
+static inline char *strcut(char **str, char sep)
+{
+	char *tok = *str, *p;
+
+	if (!tok)
+		return NULL;
+
+	p = sep ? strchr(tok, sep) : NULL;
+	if (p)
+		*p++ = '\0';
+	*str = p;
+	return tok;
+}
+
+/** Wildcard string matching, '*' matches any run of characters and '?'
+ *  exactly one, case is ignored.
  *  Example:
  *  \code
  *	char *string = "hello_world";
- *	if (strwildmatch("_*", string))
+ *	if (strwildmatch("hello_*", string) == 0)
  *		...
  *  \endcode
  *
- *  Returns: 1 on success, 0 on failure.
+ *  Returns: 0 on match (like strcmp()), non-zero otherwise.
+ *  See csnippets/wildpat.h to match many strings against one pattern.
  */
 int strwildmatch(const char *pattern, const char *string);
 
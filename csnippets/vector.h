@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2013 Ahmed Samy  <f.fallen45@gmail.com>
+ * Licensed under MIT, see LICENSE.MIT for details.
+ */
+#ifndef _VECTOR_H
+#define _VECTOR_H
+
+/**
+ * Growable arrays.
+ *
+ * vector_t is an array of pointers with a separate length and capacity:
+ * the capacity doubles when it runs out, so pushing is amortized O(1),
+ * and popping never gives memory back.
+ *
+ * For tables where items are added and removed at random (fd or id
+ * tables, the old "sparse" use of stack_t), vector_slot_add() and
+ * vector_slot_del() reuse the holes left by deleted items through a list
+ * of free indices, so finding a slot is O(1) too.
+ *
+ * VECTOR_DEFINE_TYPE() generates the same thing for any element type,
+ * stored by value.
+ */
+typedef struct vector {
+	void **items;
+	size_t len, cap;
+
+	/* Indices of the holes left by vector_slot_del().  */
+	size_t *holes;
+	size_t nholes, holes_cap;
+} vector_t;
+
+#define VECTOR_INITIALIZER	{ NULL, 0, 0, NULL, 0, 0 }
+#define VECTOR_MIN_SIZE		8
+
+/**
+ * vector_init - initialize a vector, room for @cap items is reserved
+ * @v: the vector
+ * @cap: initial capacity, may be 0
+ *
+ * Example:
+ *	vector_t v;
+ *	if (!vector_init(&v, 0))
+ *		...
+ */
+extern bool vector_init(vector_t *v, size_t cap);
+
+/* vector_free - free the array, @destructor is called on each non-NULL item
+ * if given.  */
+extern void vector_free(vector_t *v, void (*destructor) (void *));
+
+/* vector_reserve - make room for at least @cap items.  */
+extern bool vector_reserve(vector_t *v, size_t cap);
+
+static inline bool vector_push(vector_t *v, void *item)
+{
+	if (unlikely(v->len == v->cap) && !vector_reserve(v, v->len + 1))
+		return false;
+	v->items[v->len++] = item;
+	return true;
+}
+
+/* Returns NULL if the vector is empty.  */
+static inline void *vector_pop(vector_t *v)
+{
+	return v->len ? v->items[--v->len] : NULL;
+}
+
+static inline void *vector_top(const vector_t *v)
+{
+	return v->len ? v->items[v->len - 1] : NULL;
+}
+
+static inline void *vector_get(const vector_t *v, size_t i)
+{
+	return i < v->len ? v->items[i] : NULL;
+}
+
+/* vector_remove - remove item @i, keeping the order of the others.  */
+extern void *vector_remove(vector_t *v, size_t i);
+
+/* vector_remove_fast - remove item @i, the last item takes its place.  */
+static inline void *vector_remove_fast(vector_t *v, size_t i)
+{
+	void *item = v->items[i];
+
+	v->items[i] = v->items[--v->len];
+	return item;
+}
+
+/**
+ * vector_slot_add - put @item in a free slot
+ *
+ * Reuses the hole left by the last vector_slot_del(), or appends.
+ * Returns the index of @item or -1 if we ran out of memory.
+ */
+extern long vector_slot_add(vector_t *v, void *item);
+
+/**
+ * vector_slot_del - empty slot @i, which becomes NULL
+ *
+ * @i must come from vector_slot_add().  Returns the item that was there.
+ * Don't mix this with vector_pop() or the remove functions, they move
+ * items around.
+ */
+extern void *vector_slot_del(vector_t *v, size_t i);
+
+#define vector_foreach(v, out)						\
+	for ((out) = &(v)->items[0]; (out) < &(v)->items[(v)->len]; ++(out))
+
+/**
+ * VECTOR_DEFINE_TYPE - create a vector of @type stored by value
+ * @type: the element type
+ * @name: a prefix for all the functions to define (of form <name>_*)
+ *
+ * This defines:
+ *	struct <name> { type *items; size_t len, cap; };
+ *	void <name>_init(struct <name> *);
+ *	void <name>_free(struct <name> *);
+ *	bool <name>_reserve(struct <name> *, size_t cap);
+ *	bool <name>_push(struct <name> *, type item);
+ *	bool <name>_pop(struct <name> *, type *out);
+ *	type *<name>_top(const struct <name> *);	(NULL if empty)
+ *
+ * Items are v->items[0] to v->items[v->len - 1].
+ *
+ * Example:
+ *	VECTOR_DEFINE_TYPE(struct pollfd, pollfd_vec);
+ *
+ *	static struct pollfd_vec fds;
+ *
+ *	if (!pollfd_vec_push(&fds, (struct pollfd) { .fd = fd, .events = POLLIN }))
+ *		...
+ */
+#define VECTOR_DEFINE_TYPE(type, name)					\
+	struct name { type *items; size_t len, cap; };			\
+	static inline void name##_init(struct name *v)			\
+	{								\
+		v->items = NULL;					\
+		v->len = v->cap = 0;					\
+	}								\
+	static inline void name##_free(struct name *v)			\
+	{								\
+		free(v->items);						\
+		name##_init(v);						\
+	}								\
+	static inline __cold bool name##_reserve(struct name *v, size_t cap) \
+	{								\
+		size_t ncap = v->cap ? v->cap : VECTOR_MIN_SIZE;	\
+		type *tmp;						\
+									\
+		if (cap <= v->cap)					\
+			return true;					\
+		while (ncap < cap)					\
+			ncap *= 2;					\
+		tmp = realloc(v->items, ncap * sizeof(type));		\
+		if (!tmp)						\
+			return false;					\
+		v->items = tmp;						\
+		v->cap = ncap;						\
+		return true;						\
+	}								\
+	static inline bool name##_push(struct name *v, type item)	\
+	{								\
+		if (unlikely(v->len == v->cap)				\
+		    && !name##_reserve(v, v->len + 1))			\
+			return false;					\
+		v->items[v->len++] = item;				\
+		return true;						\
+	}								\
+	static inline bool name##_pop(struct name *v, type *out)	\
+	{								\
+		if (!v->len)						\
+			return false;					\
+		*out = v->items[--v->len];				\
+		return true;						\
+	}								\
+	static inline type *name##_top(const struct name *v)		\
+	{								\
+		return v->len ? &v->items[v->len - 1] : NULL;		\
+	}
+
+#endif /* _VECTOR_H */
@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2013 Ahmed Samy  <f.fallen45@gmail.com>
+ * Licensed under MIT, see LICENSE.MIT for details.
+ */
+#ifndef _WILDPAT_H
+#define _WILDPAT_H
+
+/**
+ * Compiled wildcard patterns.
+ *
+ * Same syntax and case folding as strwildmatch(): '*' matches any run of
+ * characters, '?' exactly one, everything else itself ignoring case.
+ * The pattern is parsed once into the literal runs between the stars, so
+ * matching many strings against it does no parsing and no toupper()
+ * calls, and never backtracks past the run it's looking for: the run
+ * before the first star must be at the start of the string, the one
+ * after the last star at its end, and the others are searched for left
+ * to right with memchr().
+ *
+ * Case folding uses the locale that was current when the pattern was
+ * compiled.
+ *
+ * Example:
+ *	wildpat_t *w = wildpat_compile("*.example.com");
+ *
+ *	if (wildpat_match(w, host))
+ *		...
+ *	wildpat_free(w);
+ */
+typedef struct wildpat wildpat_t;
+
+/* Returns NULL if we ran out of memory.  */
+extern wildpat_t *wildpat_compile(const char *pattern);
+extern void wildpat_free(wildpat_t *w);
+
+/* Returns true if @str matches (unlike strwildmatch()).  */
+extern bool wildpat_match(const wildpat_t *w, const char *str);
+extern bool wildpat_matchn(const wildpat_t *w, const char *str, size_t len);
+
+#endif /* _WILDPAT_H */
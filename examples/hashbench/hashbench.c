@@ -0,0 +1,481 @@
+/*
+ * Benchmark and quality checks for the functions in hash.h.
+ *
+ *	hashbench [-q] [function...]
+ *
+ * For every function (or just the ones named) this prints:
+ *	- throughput in bytes per cycle for keys of 4 bytes up to 1 MB,
+ *	  from an aligned and from a misaligned (+1) buffer,
+ *	- latency in cycles for short keys (each call's seed depends on the
+ *	  previous result, so calls can't overlap),
+ *	- avalanche: the worst bias of any output bit when flipping any input
+ *	  bit (0 is ideal; sampling noise alone gives about 0.015, so
+ *	  anything clearly above that is a real bias),
+ *	- collisions among a million sequential and a million text keys,
+ *	  compared with what a random function would give.
+ * -q skips the quality checks.
+ *
+ * The _many() functions are timed per key next to a loop calling the
+ * single-key function on the same keys.
+ *
+ * Cycles come from the time stamp counter on x86, which ticks at the
+ * nominal frequency; elsewhere they are nanoseconds.
+ */
+#include <csnippets/hash.h>
+
+#include <stdio.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define UNIT	"cycle"
+static inline uint64_t ticks(void)
+{
+	return __rdtsc();
+}
+#else
+#define UNIT	"ns"
+static inline uint64_t ticks(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+#endif
+
+struct hashfn {
+	const char *name;
+	int bits;
+	size_t elem;	/* the function hashes @len / @elem elements */
+	uint64_t (*fn)(const void *key, size_t len, uint64_t seed);
+};
+
+static uint64_t h_any(const void *k, size_t len, uint64_t seed)
+{
+	return hash_any(k, len, seed);
+}
+
+static uint64_t h_stable_8(const void *k, size_t len, uint64_t seed)
+{
+	return hash_stable_8(k, len, seed);
+}
+
+static uint64_t h_stable_16(const void *k, size_t len, uint64_t seed)
+{
+	return hash_stable_16(k, len / 2, seed);
+}
+
+static uint64_t h_stable_32(const void *k, size_t len, uint64_t seed)
+{
+	return hash_stable_32(k, len / 4, seed);
+}
+
+static uint64_t h_stable_64(const void *k, size_t len, uint64_t seed)
+{
+	return hash_stable_64(k, len / 8, seed);
+}
+
+static uint64_t h_u32(const void *k, size_t len, uint64_t seed)
+{
+	return hash_u32(k, len / 4, seed);
+}
+
+static uint64_t h64_any(const void *k, size_t len, uint64_t seed)
+{
+	return hash64_any(k, len, seed);
+}
+
+static uint64_t h64_stable_8(const void *k, size_t len, uint64_t seed)
+{
+	return hash64_stable_8(k, len, seed);
+}
+
+static uint64_t h64_stable_16(const void *k, size_t len, uint64_t seed)
+{
+	return hash64_stable_16(k, len / 2, seed);
+}
+
+static uint64_t h64_stable_32(const void *k, size_t len, uint64_t seed)
+{
+	return hash64_stable_32(k, len / 4, seed);
+}
+
+static uint64_t h64_stable_64(const void *k, size_t len, uint64_t seed)
+{
+	return hash64_stable_64(k, len / 8, seed);
+}
+
+static uint64_t h64_fast(const void *k, size_t len, uint64_t seed)
+{
+	return hash64_fast_any(k, len, seed);
+}
+
+/* The streaming versions are fed in 1500 byte (one packet) pieces.  */
+#define CHUNK	1500
+
+static uint64_t h_any_stream(const void *k, size_t len, uint64_t seed)
+{
+	struct hash_state st;
+	size_t off;
+
+	hash_any_init(&st, len, seed);
+	for (off = 0; off < len; off += CHUNK)
+		hash_any_update(&st, (const char *)k + off,
+				len - off < CHUNK ? len - off : CHUNK);
+	return hash_any_final(&st);
+}
+
+static uint64_t h64_fast_stream(const void *k, size_t len, uint64_t seed)
+{
+	struct hash64_fast_state st;
+	size_t off;
+
+	hash64_fast_init(&st, seed);
+	for (off = 0; off < len; off += CHUNK)
+		hash64_fast_update(&st, (const char *)k + off,
+				   len - off < CHUNK ? len - off : CHUNK);
+	return hash64_fast_final(&st);
+}
+
+static const struct hashfn hashfns[] = {
+	{ "hash_any",		32, 1, h_any },
+	{ "hash_stable_8",	32, 1, h_stable_8 },
+	{ "hash_stable_16",	32, 2, h_stable_16 },
+	{ "hash_stable_32",	32, 4, h_stable_32 },
+	{ "hash_stable_64",	32, 8, h_stable_64 },
+	{ "hash_u32",		32, 4, h_u32 },
+	{ "hash_any_stream",	32, 1, h_any_stream },
+	{ "hash64_any",		64, 1, h64_any },
+	{ "hash64_stable_8",	64, 1, h64_stable_8 },
+	{ "hash64_stable_16",	64, 2, h64_stable_16 },
+	{ "hash64_stable_32",	64, 4, h64_stable_32 },
+	{ "hash64_stable_64",	64, 8, h64_stable_64 },
+	{ "hash64_fast",	64, 1, h64_fast },
+	{ "hash64_fast_stream",	64, 1, h64_fast_stream },
+};
+#define NHASHFNS	(sizeof(hashfns) / sizeof(hashfns[0]))
+
+static const size_t sizes[] = {
+	4, 8, 16, 32, 64, 128, 256, 1024, 4096, 65536, 1 << 20
+};
+#define NSIZES		(sizeof(sizes) / sizeof(sizes[0]))
+
+/* Don't let the compiler drop calls whose results are unused.  */
+static volatile uint64_t sink;
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ull;
+static uint64_t rng(void)
+{
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 7;
+	rng_state ^= rng_state << 17;
+	return rng_state;
+}
+
+/* Best of a few runs of enough calls to last ~20ms each.  */
+static double per_call(const struct hashfn *h, const uint8_t *buf, size_t len,
+		       bool chained)
+{
+	size_t i, n = (16 << 20) / (len + 32) + 16;
+	double best = 1e30;
+	int run;
+
+	for (run = 0; run < 5; run++) {
+		uint64_t t, x = 0;
+
+		t = ticks();
+		if (chained)
+			for (i = 0; i < n; i++)
+				x = h->fn(buf, len, x);
+		else
+			for (i = 0; i < n; i++)
+				x += h->fn(buf, len, i);
+		t = ticks() - t;
+		sink = x;
+
+		if ((double)t / n < best)
+			best = (double)t / n;
+	}
+
+	return best;
+}
+
+static void bench(const struct hashfn *h, uint8_t *buf)
+{
+	size_t i;
+
+	printf("\n%s: bytes/%s (aligned, unaligned)\n", h->name, UNIT);
+	for (i = 0; i < NSIZES; i++) {
+		double a, u;
+
+		if (sizes[i] < h->elem)
+			continue;
+		a = per_call(h, buf, sizes[i], false);
+		u = per_call(h, buf + 1, sizes[i], false);
+		printf("  %8zu B  %7.3f  %7.3f\n", sizes[i], sizes[i] / a, sizes[i] / u);
+	}
+
+	printf("  latency (%s/call):", UNIT);
+	for (i = 0; i < 4; i++)
+		if (sizes[i] >= h->elem)
+			printf("  %zuB %.1f", sizes[i], per_call(h, buf, sizes[i], true));
+	printf("\n");
+}
+
+/* Worst |P(output bit flips) - 1/2| over every (input bit, output bit).  */
+static double avalanche(const struct hashfn *h, size_t len)
+{
+	enum { TRIALS = 20000 };
+	static uint32_t flips[64 * 8][64];
+	uint8_t key[64];
+	double worst = 0;
+	size_t t, ib;
+	int ob;
+
+	memset(flips, 0, sizeof(flips));
+	for (t = 0; t < TRIALS; t++) {
+		uint64_t h0;
+
+		for (ib = 0; ib < len; ib++)
+			key[ib] = rng();
+		h0 = h->fn(key, len, 0);
+		for (ib = 0; ib < len * 8; ib++) {
+			uint64_t d;
+
+			key[ib / 8] ^= 1 << (ib % 8);
+			d = h0 ^ h->fn(key, len, 0);
+			key[ib / 8] ^= 1 << (ib % 8);
+			for (ob = 0; ob < h->bits; ob++)
+				flips[ib][ob] += (d >> ob) & 1;
+		}
+	}
+
+	for (ib = 0; ib < len * 8; ib++)
+		for (ob = 0; ob < h->bits; ob++) {
+			double bias = (double)flips[ib][ob] / TRIALS - 0.5;
+
+			if (bias < 0)
+				bias = -bias;
+			if (bias > worst)
+				worst = bias;
+		}
+	return worst;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Number of keys that share a (@bits wide) hash with an earlier key.  */
+static size_t collisions(uint64_t *hs, size_t n, int bits)
+{
+	uint64_t mask = bits == 64 ? ~0ull : (1ull << bits) - 1;
+	size_t i, c = 0;
+
+	for (i = 0; i < n; i++)
+		hs[i] &= mask;
+	qsort(hs, n, sizeof(*hs), cmp_u64);
+	for (i = 1; i < n; i++)
+		c += hs[i] == hs[i - 1];
+	return c;
+}
+
+static void quality(const struct hashfn *h)
+{
+	enum { NKEYS = 1 << 20 };
+	static const size_t alens[] = { 4, 8, 16, 64 };
+	uint64_t *hs;
+	size_t i, klen;
+	double expect;
+
+	printf("  avalanche bias:");
+	for (i = 0; i < sizeof(alens) / sizeof(alens[0]); i++)
+		if (alens[i] >= h->elem)
+			printf("  %zuB %.4f", alens[i], avalanche(h, alens[i]));
+	printf("\n");
+
+	xmalloc(hs, NKEYS * sizeof(*hs), return);
+
+	/* Expected collisions for n random 32-bit values, n^2 / 2m.  */
+	expect = (double)NKEYS * (NKEYS - 1) / 2 / 4294967296.0;
+
+	/* Sequential keys are padded with zeroes to a whole element.  */
+	klen = h->elem > sizeof(uint32_t) ? h->elem : sizeof(uint32_t);
+	for (i = 0; i < NKEYS; i++) {
+		uint8_t k[8] = { 0 };
+		uint32_t n = i;
+
+		memcpy(k, &n, sizeof(n));
+		hs[i] = h->fn(k, klen, 0);
+	}
+	printf("  collisions, %d sequential u32 keys: %zu in 32 bits (random: %.0f)",
+	       NKEYS, collisions(hs, NKEYS, 32), expect);
+	if (h->bits == 64) {
+		for (i = 0; i < NKEYS; i++) {
+			uint8_t k[8] = { 0 };
+			uint32_t n = i;
+
+			memcpy(k, &n, sizeof(n));
+			hs[i] = h->fn(k, klen, 0);
+		}
+		printf(", %zu in 64", collisions(hs, NKEYS, 64));
+	}
+	printf("\n");
+
+	for (i = 0; i < NKEYS; i++) {
+		char k[32] = { 0 };
+		int len = snprintf(k, sizeof(k), "user:%zu", i);
+
+		/* Some only look at whole elements.  */
+		len = (len + h->elem - 1) / h->elem * h->elem;
+		hs[i] = h->fn(k, len, 0);
+	}
+	printf("  collisions, %d \"user:N\" keys: %zu in 32 bits (random: %.0f)\n",
+	       NKEYS, collisions(hs, NKEYS, 32), expect);
+
+	free(hs);
+}
+
+/* Keys hashed per run of the _many() benchmarks.  */
+#define MANY_KEYS	1024
+
+enum many_kind { MANY_U32, MANY_ANY, MANY64_ANY };
+
+/* Best of a few runs over MANY_KEYS keys of @len bytes at @buf, in ticks
+ * per key, through the _many() function (@bulk) or a loop of single
+ * calls.  */
+static double per_key(enum many_kind kind, const uint8_t *buf, size_t len,
+		      bool bulk)
+{
+	static const void *keys[MANY_KEYS];
+	static size_t lens[MANY_KEYS];
+	static uint32_t h32[MANY_KEYS];
+	static uint64_t h64[MANY_KEYS];
+	size_t i, rep, n = (4 << 20) / (MANY_KEYS * (len + 16)) + 4;
+	double best = 1e30;
+	int run;
+
+	for (i = 0; i < MANY_KEYS; i++) {
+		keys[i] = buf + i * len;
+		lens[i] = len;
+	}
+
+	for (run = 0; run < 5; run++) {
+		uint64_t t = ticks();
+
+		for (rep = 0; rep < n; rep++) {
+			switch (kind) {
+			case MANY_U32:
+				if (bulk)
+					hash_u32_many((const uint32_t *)buf, len / 4,
+						      MANY_KEYS, rep, h32);
+				else
+					for (i = 0; i < MANY_KEYS; i++)
+						h32[i] = hash_u32(keys[i], len / 4, rep);
+				break;
+			case MANY_ANY:
+				if (bulk)
+					hash_any_many(keys, lens, MANY_KEYS, rep, h32);
+				else
+					for (i = 0; i < MANY_KEYS; i++)
+						h32[i] = hash_any(keys[i], len, rep);
+				break;
+			case MANY64_ANY:
+				if (bulk)
+					hash64_any_many(keys, lens, MANY_KEYS, rep, h64);
+				else
+					for (i = 0; i < MANY_KEYS; i++)
+						h64[i] = hash64_any(keys[i], len, rep);
+				break;
+			}
+			sink = h32[rep % MANY_KEYS] + h64[rep % MANY_KEYS];
+		}
+		t = ticks() - t;
+
+		if ((double)t / (n * MANY_KEYS) < best)
+			best = (double)t / (n * MANY_KEYS);
+	}
+
+	return best;
+}
+
+static void bench_many(const char *name, enum many_kind kind, const uint8_t *buf)
+{
+	static const size_t klens[] = { 4, 8, 16, 32, 64 };
+	size_t i;
+
+	printf("\n%s: %s/key (bulk, one at a time)\n", name, UNIT);
+	for (i = 0; i < sizeof(klens) / sizeof(klens[0]); i++)
+		printf("  %8zu B  %7.2f  %7.2f\n", klens[i],
+		       per_key(kind, buf, klens[i], true),
+		       per_key(kind, buf, klens[i], false));
+}
+
+/* No names on the command line means all of them.  */
+static bool wanted(const char *name, int arg, int argc, char **argv)
+{
+	for (; arg < argc; arg++)
+		if (strcmp(argv[arg], name) == 0)
+			return true;
+	return false;
+}
+
+int main(int argc, char **argv)
+{
+	bool do_quality = true;
+	uint8_t *buf;
+	size_t i;
+	int arg = 1;
+
+	if (arg < argc && strcmp(argv[arg], "-q") == 0) {
+		do_quality = false;
+		arg++;
+	}
+
+	/* 8 extra bytes for the misaligned runs and hash_string().  */
+	xmalloc(buf, (1 << 20) + 8, return 1);
+	for (i = 0; i < (1 << 20) + 8; i++)
+		buf[i] = rng() % 255 + 1;
+
+	for (i = 0; i < NHASHFNS; i++) {
+		if (arg < argc && !wanted(hashfns[i].name, arg, argc, argv))
+			continue;
+
+		bench(&hashfns[i], buf);
+		if (do_quality)
+			quality(&hashfns[i]);
+	}
+
+	if (arg == argc || wanted("hash_u32_many", arg, argc, argv))
+		bench_many("hash_u32_many", MANY_U32, buf);
+	if (arg == argc || wanted("hash_any_many", arg, argc, argv))
+		bench_many("hash_any_many", MANY_ANY, buf);
+	if (arg == argc || wanted("hash64_any_many", arg, argc, argv))
+		bench_many("hash64_any_many", MANY64_ANY, buf);
+
+	/* hash_string() has its own signature, only time it.  */
+	if (arg == argc) {
+		printf("\nhash_string: %s/call\n", UNIT);
+		for (i = 0; i < 4; i++) {
+			uint64_t t, x = 0;
+			size_t k, n = 1 << 20;
+
+			buf[sizes[i]] = '\0';
+			t = ticks();
+			for (k = 0; k < n; k++)
+				x += hash_string((const char *)buf);
+			t = ticks() - t;
+			sink = x;
+			buf[sizes[i]] = 1;
+			printf("  %zuB %.1f", sizes[i], (double)t / n);
+		}
+		printf("\n");
+	}
+
+	free(buf);
+	return 0;
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2013 Ahmed Samy  <f.fallen45@gmail.com>
+ * Licensed under MIT, see LICENSE.MIT for details.
+ */
+#include <csnippets/arena.h>
+
+#include <pthread.h>
+
+static inline char *chunk_start(struct arena_chunk *c)
+{
+	uintptr_t p = (uintptr_t)c->data;
+
+	return (char *)((p + ARENA_ALIGN - 1) & ~(uintptr_t)(ARENA_ALIGN - 1));
+}
+
+void arena_init(arena_t *a, size_t chunk_size)
+{
+	a->pos = a->end = NULL;
+	a->cur = a->head = NULL;
+	a->chunk_size = chunk_size ? chunk_size : ARENA_CHUNK_SIZE;
+}
+
+void arena_free(arena_t *a)
+{
+	struct arena_chunk *c, *next;
+
+	for (c = a->head; c; c = next) {
+		next = c->next;
+		free(c);
+	}
+
+	arena_init(a, a->chunk_size);
+}
+
+void __cold *arena_alloc_slow(arena_t *a, size_t size)
+{
+	struct arena_chunk *c = a->cur ? a->cur->next : a->head;
+	size_t csize;
+
+	if (size > SIZE_MAX / 2)
+		return NULL;
+	size = size ? (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1)
+		    : ARENA_ALIGN;
+
+	/* Chunks after the current one are free, after a reset or restore;
+	 * use the next one unless it's too small for this.  */
+	if (!c || (size_t)(c->end - chunk_start(c)) < size) {
+		csize = a->chunk_size;
+		if (csize < size)
+			csize = size;
+		csize += sizeof(*c) + ARENA_ALIGN;
+
+		c = malloc(csize);
+		if (!c)
+			return NULL;
+		c->end = (char *)c + csize;
+
+		if (a->cur) {
+			c->next = a->cur->next;
+			a->cur->next = c;
+		} else {
+			c->next = a->head;
+			a->head = c;
+		}
+	}
+
+	a->cur = c;
+	a->pos = chunk_start(c) + size;
+	a->end = c->end;
+	return chunk_start(c);
+}
+
+void *arena_memdup(arena_t *a, const void *p, size_t size)
+{
+	void *ret = arena_alloc(a, size);
+
+	if (ret)
+		memcpy(ret, p, size);
+	return ret;
+}
+
+char *arena_strndup(arena_t *a, const char *s, size_t n)
+{
+	char *ret;
+
+	n = strnlen(s, n);
+	ret = arena_alloc(a, n + 1);
+	if (ret) {
+		memcpy(ret, s, n);
+		ret[n] = '\0';
+	}
+	return ret;
+}
+
+char *arena_strdup(arena_t *a, const char *s)
+{
+	return arena_memdup(a, s, strlen(s) + 1);
+}
+
+static pthread_key_t thread_key;
+static pthread_once_t thread_once = PTHREAD_ONCE_INIT;
+
+static void arena_thread_exit(void *p)
+{
+	arena_free(p);
+	free(p);
+}
+
+static void arena_thread_key(void)
+{
+	pthread_key_create(&thread_key, arena_thread_exit);
+}
+
+arena_t *arena_thread(void)
+{
+	arena_t *a;
+
+	pthread_once(&thread_once, arena_thread_key);
+	a = pthread_getspecific(thread_key);
+	if (likely(a))
+		return a;
+
+	a = malloc(sizeof(*a));
+	if (!a)
+		return NULL;
+	arena_init(a, 0);
+	if (pthread_setspecific(thread_key, a) != 0) {
+		free(a);
+		return NULL;
+	}
+	return a;
+}
@@ -0,0 +1,486 @@
+/*
+ * Copyright (c) 2013 Ahmed Samy  <f.fallen45@gmail.com>
+ * Licensed under MIT, see LICENSE.MIT for details.
+ */
+#include <csnippets/bptree.h>
+
+/* Every node but the root keeps at least this many keys.  */
+#define MIN_KEYS	(BPTREE_ORDER / 2)
+
+static inline int bp_cmp(const bp_tree *tree, const void *a, const void *b)
+{
+	if (likely(!tree->compare))
+		return ((intptr_t)a > (intptr_t)b) - ((intptr_t)a < (intptr_t)b);
+	return tree->compare(a, b);
+}
+
+/* Index of the first key >= @key (or > @key when @upper).  */
+static inline int bp_search(const bp_tree *tree, const bp_node *node,
+			    const void *key, bool upper)
+{
+	int lo = 0, hi = node->n;
+
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		int c = bp_cmp(tree, node->keys[mid], key);
+
+		if (c < 0 || (upper && c == 0))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/* The leaf where @key is, or would be inserted (after equal keys when
+ * @upper).  */
+static bp_leaf *bp_find_leaf(const bp_tree *tree, const void *key, bool upper)
+{
+	bp_node *node = tree->root;
+
+	if (!node)
+		return NULL;
+	while (!node->leaf)
+		node = ((bp_inner *)node)->child[bp_search(tree, node, key, upper)];
+	return (bp_leaf *)node;
+}
+
+static inline int bp_child_index(const bp_inner *parent, const bp_node *child)
+{
+	int i;
+
+	for (i = 0; parent->child[i] != child; i++)
+		;
+	return i;
+}
+
+bp_tree *bptree_create(int (*compare) (const void *, const void *),
+		       void (*destroy_key) (void *),
+		       void (*destroy_info) (void *))
+{
+	bp_tree *tree;
+
+	xmalloc(tree, sizeof(*tree), return NULL);
+	tree->compare = compare;
+	tree->destroy_key = destroy_key;
+	tree->destroy_info = destroy_info;
+	return tree;
+}
+
+static void bp_destroy_node(bp_tree *tree, bp_node *node)
+{
+	int i;
+
+	if (node->leaf) {
+		bp_leaf *leaf = (bp_leaf *)node;
+
+		for (i = 0; i < node->n; i++) {
+			if (tree->destroy_key)
+				tree->destroy_key(node->keys[i]);
+			if (tree->destroy_info)
+				tree->destroy_info(leaf->infos[i]);
+		}
+	} else {
+		for (i = 0; i <= node->n; i++)
+			bp_destroy_node(tree, ((bp_inner *)node)->child[i]);
+	}
+
+	free(node);
+}
+
+void bptree_destroy(bp_tree *tree)
+{
+	if (tree->root)
+		bp_destroy_node(tree, tree->root);
+	free(tree);
+}
+
+/* Inner nodes a split may need, one per level plus a new root.  */
+struct bp_spare {
+	bp_inner *nodes[64];
+	int n;
+};
+
+/* Insert @sep and @right after @left in @left's parent, splitting the
+ * parents as needed with nodes taken from @spare.  */
+static void bp_insert_parent(bp_tree *tree, bp_node *left, void *sep,
+			     bp_node *right, struct bp_spare *spare)
+{
+	void *keys[BPTREE_ORDER + 1];
+	bp_node *child[BPTREE_ORDER + 2];
+	bp_inner *parent = left->parent, *new;
+	int i, idx, mid;
+
+	if (!parent) {
+		parent = spare->nodes[--spare->n];
+		parent->h.n = 1;
+		parent->h.keys[0] = sep;
+		parent->child[0] = left;
+		parent->child[1] = right;
+		left->parent = right->parent = parent;
+		tree->root = &parent->h;
+		return;
+	}
+
+	idx = bp_child_index(parent, left);
+	if (parent->h.n < BPTREE_ORDER) {
+		memmove(&parent->h.keys[idx + 1], &parent->h.keys[idx],
+			(parent->h.n - idx) * sizeof(void *));
+		memmove(&parent->child[idx + 2], &parent->child[idx + 1],
+			(parent->h.n - idx) * sizeof(bp_node *));
+		parent->h.keys[idx] = sep;
+		parent->child[idx + 1] = right;
+		parent->h.n++;
+		right->parent = parent;
+		return;
+	}
+
+	/* Lay out the overfull node, then cut it in two around the middle
+	 * key, which moves up.  */
+	memcpy(keys, parent->h.keys, idx * sizeof(void *));
+	keys[idx] = sep;
+	memcpy(&keys[idx + 1], &parent->h.keys[idx],
+	       (BPTREE_ORDER - idx) * sizeof(void *));
+	memcpy(child, parent->child, (idx + 1) * sizeof(bp_node *));
+	child[idx + 1] = right;
+	memcpy(&child[idx + 2], &parent->child[idx + 1],
+	       (BPTREE_ORDER - idx) * sizeof(bp_node *));
+	right->parent = parent;
+
+	mid = (BPTREE_ORDER + 1) / 2;
+	parent->h.n = mid;
+	memcpy(parent->h.keys, keys, mid * sizeof(void *));
+	memcpy(parent->child, child, (mid + 1) * sizeof(bp_node *));
+
+	new = spare->nodes[--spare->n];
+	new->h.n = BPTREE_ORDER - mid;
+	memcpy(new->h.keys, &keys[mid + 1], new->h.n * sizeof(void *));
+	memcpy(new->child, &child[mid + 1], (new->h.n + 1) * sizeof(bp_node *));
+	for (i = 0; i <= new->h.n; i++)
+		new->child[i]->parent = new;
+
+	new->h.parent = parent->h.parent;
+	bp_insert_parent(tree, &parent->h, keys[mid], &new->h, spare);
+}
+
+/* Allocate every node splitting @leaf may take, so that we never fail
+ * half way through.  */
+static bool bp_alloc_spare(const bp_leaf *leaf, struct bp_spare *spare)
+{
+	bp_inner *p = leaf->h.parent;
+	int need = 0;
+
+	while (p && p->h.n == BPTREE_ORDER) {
+		need++;
+		p = p->h.parent;
+	}
+	if (!p)
+		need++;		/* a new root */
+
+	for (spare->n = 0; spare->n < need; spare->n++) {
+		xmalloc(spare->nodes[spare->n], sizeof(bp_inner),
+			goto fail);
+	}
+	return true;
+
+fail:
+	while (spare->n > 0)
+		free(spare->nodes[--spare->n]);
+	return false;
+}
+
+bool bptree_insert(bp_tree *tree, void *key, void *info)
+{
+	bp_leaf *leaf = bp_find_leaf(tree, key, true), *new;
+	void *keys[BPTREE_ORDER + 1], *infos[BPTREE_ORDER + 1];
+	struct bp_spare spare;
+	int pos, mid;
+
+	if (!leaf) {
+		xmalloc(leaf, sizeof(*leaf), return false);
+		leaf->h.leaf = true;
+		tree->root = &leaf->h;
+	}
+
+	pos = bp_search(tree, &leaf->h, key, true);
+	if (leaf->h.n < BPTREE_ORDER) {
+		memmove(&leaf->h.keys[pos + 1], &leaf->h.keys[pos],
+			(leaf->h.n - pos) * sizeof(void *));
+		memmove(&leaf->infos[pos + 1], &leaf->infos[pos],
+			(leaf->h.n - pos) * sizeof(void *));
+		leaf->h.keys[pos] = key;
+		leaf->infos[pos] = info;
+		leaf->h.n++;
+		tree->count++;
+		return true;
+	}
+
+	xmalloc(new, sizeof(*new), return false);
+	if (!bp_alloc_spare(leaf, &spare)) {
+		free(new);
+		return false;
+	}
+
+	memcpy(keys, leaf->h.keys, pos * sizeof(void *));
+	memcpy(infos, leaf->infos, pos * sizeof(void *));
+	keys[pos] = key;
+	infos[pos] = info;
+	memcpy(&keys[pos + 1], &leaf->h.keys[pos], (BPTREE_ORDER - pos) * sizeof(void *));
+	memcpy(&infos[pos + 1], &leaf->infos[pos], (BPTREE_ORDER - pos) * sizeof(void *));
+
+	mid = (BPTREE_ORDER + 1) / 2;
+	leaf->h.n = mid;
+	memcpy(leaf->h.keys, keys, mid * sizeof(void *));
+	memcpy(leaf->infos, infos, mid * sizeof(void *));
+
+	new->h.leaf = true;
+	new->h.n = BPTREE_ORDER + 1 - mid;
+	memcpy(new->h.keys, &keys[mid], new->h.n * sizeof(void *));
+	memcpy(new->infos, &infos[mid], new->h.n * sizeof(void *));
+	new->h.parent = leaf->h.parent;
+
+	new->prev = leaf;
+	new->next = leaf->next;
+	if (leaf->next)
+		leaf->next->prev = new;
+	leaf->next = new;
+
+	bp_insert_parent(tree, &leaf->h, new->h.keys[0], &new->h, &spare);
+	assert(spare.n == 0);
+
+	tree->count++;
+	return true;
+}
+
+/* Remove key @idx and child @idx + 1 from @node.  */
+static void bp_inner_remove(bp_inner *node, int idx)
+{
+	memmove(&node->h.keys[idx], &node->h.keys[idx + 1],
+		(node->h.n - idx - 1) * sizeof(void *));
+	memmove(&node->child[idx + 1], &node->child[idx + 2],
+		(node->h.n - idx - 1) * sizeof(bp_node *));
+	node->h.n--;
+}
+
+/* @node has MIN_KEYS - 1 keys, borrow from or merge with a sibling.  */
+static void bp_rebalance(bp_tree *tree, bp_node *node)
+{
+	bp_inner *parent = node->parent;
+	bp_node *left, *right;
+	int idx;
+
+	if (!parent) {
+		/* The root may shrink down to nothing.  */
+		if (!node->leaf && node->n == 0) {
+			tree->root = ((bp_inner *)node)->child[0];
+			tree->root->parent = NULL;
+			free(node);
+		} else if (node->leaf && node->n == 0) {
+			tree->root = NULL;
+			free(node);
+		}
+		return;
+	}
+
+	if (node->n >= MIN_KEYS)
+		return;
+
+	idx = bp_child_index(parent, node);
+	left = idx > 0 ? parent->child[idx - 1] : NULL;
+	right = idx < parent->h.n ? parent->child[idx + 1] : NULL;
+
+	if (left && left->n > MIN_KEYS) {
+		memmove(&node->keys[1], &node->keys[0], node->n * sizeof(void *));
+		if (node->leaf) {
+			bp_leaf *l = (bp_leaf *)left, *n = (bp_leaf *)node;
+
+			memmove(&n->infos[1], &n->infos[0], node->n * sizeof(void *));
+			node->keys[0] = left->keys[left->n - 1];
+			n->infos[0] = l->infos[left->n - 1];
+			parent->h.keys[idx - 1] = node->keys[0];
+		} else {
+			bp_inner *l = (bp_inner *)left, *n = (bp_inner *)node;
+
+			memmove(&n->child[1], &n->child[0], (node->n + 1) * sizeof(bp_node *));
+			node->keys[0] = parent->h.keys[idx - 1];
+			n->child[0] = l->child[left->n];
+			n->child[0]->parent = n;
+			parent->h.keys[idx - 1] = left->keys[left->n - 1];
+		}
+		node->n++;
+		left->n--;
+		return;
+	}
+
+	if (right && right->n > MIN_KEYS) {
+		if (node->leaf) {
+			bp_leaf *r = (bp_leaf *)right, *n = (bp_leaf *)node;
+
+			node->keys[node->n] = right->keys[0];
+			n->infos[node->n] = r->infos[0];
+			memmove(&r->infos[0], &r->infos[1], (right->n - 1) * sizeof(void *));
+			memmove(&right->keys[0], &right->keys[1], (right->n - 1) * sizeof(void *));
+			parent->h.keys[idx] = right->keys[0];
+		} else {
+			bp_inner *r = (bp_inner *)right, *n = (bp_inner *)node;
+
+			node->keys[node->n] = parent->h.keys[idx];
+			n->child[node->n + 1] = r->child[0];
+			n->child[node->n + 1]->parent = n;
+			parent->h.keys[idx] = right->keys[0];
+			memmove(&right->keys[0], &right->keys[1], (right->n - 1) * sizeof(void *));
+			memmove(&r->child[0], &r->child[1], right->n * sizeof(bp_node *));
+		}
+		node->n++;
+		right->n--;
+		return;
+	}
+
+	/* Both siblings are minimal: merge with one of them, always into
+	 * the left node of the pair.  */
+	if (!left) {
+		left = node;
+		node = right;
+		idx++;
+	}
+
+	if (left->leaf) {
+		bp_leaf *l = (bp_leaf *)left, *n = (bp_leaf *)node;
+
+		memcpy(&left->keys[left->n], node->keys, node->n * sizeof(void *));
+		memcpy(&l->infos[left->n], n->infos, node->n * sizeof(void *));
+		l->next = n->next;
+		if (n->next)
+			n->next->prev = l;
+	} else {
+		bp_inner *l = (bp_inner *)left, *n = (bp_inner *)node;
+		int i;
+
+		left->keys[left->n++] = parent->h.keys[idx - 1];
+		memcpy(&left->keys[left->n], node->keys, node->n * sizeof(void *));
+		memcpy(&l->child[left->n], n->child, (node->n + 1) * sizeof(bp_node *));
+		for (i = 0; i <= node->n; i++)
+			n->child[i]->parent = l;
+	}
+	left->n += node->n;
+	free(node);
+
+	bp_inner_remove(parent, idx - 1);
+	bp_rebalance(tree, &parent->h);
+}
+
+void bptree_remove(bp_tree *tree, bp_cursor *c)
+{
+	bp_leaf *leaf = c->leaf;
+	int pos = c->pos;
+
+	if (tree->destroy_key)
+		tree->destroy_key(leaf->h.keys[pos]);
+	if (tree->destroy_info)
+		tree->destroy_info(leaf->infos[pos]);
+
+	memmove(&leaf->h.keys[pos], &leaf->h.keys[pos + 1],
+		(leaf->h.n - pos - 1) * sizeof(void *));
+	memmove(&leaf->infos[pos], &leaf->infos[pos + 1],
+		(leaf->h.n - pos - 1) * sizeof(void *));
+	leaf->h.n--;
+	tree->count--;
+
+	/* Separators in the parents may still be equal to the removed key,
+	 * that's fine, they only have to keep ordering the children.  */
+	bp_rebalance(tree, &leaf->h);
+	c->leaf = NULL;
+}
+
+static bool bp_bound(bp_tree *tree, const void *key, bp_cursor *c, bool upper)
+{
+	bp_leaf *leaf = bp_find_leaf(tree, key, upper);
+	int pos;
+
+	if (!leaf)
+		return false;
+
+	pos = bp_search(tree, &leaf->h, key, upper);
+	if (pos == leaf->h.n) {
+		/* Everything here is smaller, the answer is the first
+		 * entry of the next leaf.  */
+		leaf = leaf->next;
+		pos = 0;
+		if (!leaf)
+			return false;
+	}
+
+	c->leaf = leaf;
+	c->pos = pos;
+	return true;
+}
+
+bool bptree_lower_bound(bp_tree *tree, const void *key, bp_cursor *c)
+{
+	return bp_bound(tree, key, c, false);
+}
+
+bool bptree_upper_bound(bp_tree *tree, const void *key, bp_cursor *c)
+{
+	return bp_bound(tree, key, c, true);
+}
+
+bool bptree_query(bp_tree *tree, const void *key, bp_cursor *c)
+{
+	bp_cursor tmp;
+
+	if (!bp_bound(tree, key, &tmp, false)
+	    || bp_cmp(tree, bptree_key(&tmp), key) != 0)
+		return false;
+
+	*c = tmp;
+	return true;
+}
+
+bool bptree_first(bp_tree *tree, bp_cursor *c)
+{
+	bp_node *node = tree->root;
+
+	if (!node || node->n == 0)
+		return false;
+	while (!node->leaf)
+		node = ((bp_inner *)node)->child[0];
+
+	c->leaf = (bp_leaf *)node;
+	c->pos = 0;
+	return true;
+}
+
+bool bptree_last(bp_tree *tree, bp_cursor *c)
+{
+	bp_node *node = tree->root;
+
+	if (!node || node->n == 0)
+		return false;
+	while (!node->leaf)
+		node = ((bp_inner *)node)->child[node->n];
+
+	c->leaf = (bp_leaf *)node;
+	c->pos = node->n - 1;
+	return true;
+}
+
+size_t bptree_range(bp_tree *tree, const void *lo, const void *hi,
+		    void (*fn) (void *key, void *info, void *arg), void *arg)
+{
+	bp_cursor c;
+	size_t ret = 0;
+
+	if (!bptree_lower_bound(tree, lo, &c))
+		return 0;
+
+	do {
+		if (bp_cmp(tree, bptree_key(&c), hi) >= 0)
+			break;
+		fn(bptree_key(&c), bptree_info(&c), arg);
+		ret++;
+	} while (bptree_successor(&c));
+
+	return ret;
+}
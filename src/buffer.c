@@ -4,132 +4,326 @@
  */
 #include <csnippets/buffer.h>
 
-typedef struct buffer {
-	int wpos, rpos, size;
-	uint8_t *data;
-} buffer_t;
+#include <fcntl.h>
+#include <unistd.h>
+#if defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))
+#include <sys/mman.h>
+#define HAVE_MMAP
+#endif
 
-static __inline uint16_t unpack_u16(unsigned char *addr)
+#define BUFFER_MIN_SIZE	64
+
+static bool stat_file(const char *f, size_t *size)
+{
+	struct stat st;
+	if (stat(f, &st) != 0)
+		return false;
+
+	*size = st.st_size;
+	return true;
+}
+
+/* Grow @p to at least @nsize bytes, doubling so that a series of
+ * appends costs O(n) overall.  The new space is zeroed.  */
+static __cold bool bresize(buffer_t *p, size_t nsize)
+{
+	size_t ncap = p->size > BUFFER_MIN_SIZE / 2 ? p->size * 2 : BUFFER_MIN_SIZE;
+	uint8_t *n;
+
+	if (ncap < nsize)
+		ncap = nsize;
+
+#ifdef HAVE_MMAP
+	if (p->mapped) {
+		/* Copy on first write, the file is never modified.  */
+		if (!(n = malloc(ncap)))
+			return false;
+		memcpy(n, p->data, p->size);
+		munmap(p->data, p->size);
+		p->mapped = false;
+	} else
+#endif
+	if (!(n = realloc(p->data, ncap)))
+		return false;
+
+	memset(n + p->size, 0, ncap - p->size);
+	p->data = n;
+	p->size = ncap;
+	return true;
+}
+
+bool breserve(buffer_t *bp, size_t size)
+{
+	/* wpos may be past the end after a bseek().  */
+	if (likely(bp->wpos <= bp->size && size <= bp->size - bp->wpos
+		   && !bp->mapped))
+		return true;
+	if (bp->wpos + size < size)
+		return false;
+	return bresize(bp, bp->wpos + size);
+}
+
+/* The checked writers can't report errors, do what balloc() does.  */
+static inline void bensure(buffer_t *bp, size_t size)
 {
-	return addr[1] << 8 | addr[0];
+	if (unlikely(!breserve(bp, size)))
+		abort();
 }
 
-static __inline uint32_t unpack_u32(unsigned char *addr)
+uint64_t bget64(buffer_t *bp)
 {
-	return unpack_u16(addr + 2) << 16 | unpack_u16(addr);
+	return likely(bneed(bp, 8)) ? __bget64(bp) : 0;
 }
 
-static __inline void pack_u16(unsigned char *addr, uint16_t value)
+uint32_t bget32(buffer_t *bp)
 {
-	addr[1] = value >> 8;
-	addr[0] = (uint8_t)value;
+	return likely(bneed(bp, 4)) ? __bget32(bp) : 0;
 }
 
-static __inline void pack_u32(unsigned char *addr, uint32_t value)
+uint16_t bget16(buffer_t *bp)
 {
-	pack_u16(addr + 2, value >> 16);
-	pack_u16(addr,     (uint16_t)value);
+	return likely(bneed(bp, 2)) ? __bget16(bp) : 0;
 }
 
-static bool stat_file(const char *f, int *size)
+float bgetfloat(buffer_t *bp)
 {
-	struct stat st;
-	if (stat(f, &st) != 0)
+	uint32_t tmp = bget32(bp);
+	float ret;
+
+	memcpy(&ret, &tmp, sizeof(ret));
+	return ret;
+}
+
+double bgetdouble(buffer_t *bp)
+{
+	uint64_t tmp = bget64(bp);
+	double ret;
+
+	memcpy(&ret, &tmp, sizeof(ret));
+	return ret;
+}
+
+/* Decode a varint at rpos, false on malformed or cut short input (@bp is
+ * left untouched then).  */
+static bool bdecodevar(buffer_t *bp, uint64_t *ret)
+{
+	const uint8_t *p = &bp->data[bp->rpos];
+	const uint8_t *end = p + bremaining(bp);
+	uint64_t val = 0;
+	int shift = 0;
+	uint8_t byte;
+
+	do {
+		if (unlikely(p == end))
+			return false;
+		byte = *p++;
+		val |= (uint64_t)(byte & 0x7f) << shift;
+		shift += 7;
+	} while ((byte & 0x80) && shift < 7 * BVAR_MAX);
+
+	/* Longer than BVAR_MAX bytes, or bits past 64 in the last one.  */
+	if (unlikely((byte & 0x80) || (shift == 7 * BVAR_MAX && byte > 1)))
 		return false;
 
-	*size = st.st_size;
+	bp->rpos = p - bp->data;
+	*ret = val;
 	return true;
 }
 
-static void bresize(buffer_t *p, int nsize)
+uint64_t bgetvar(buffer_t *bp)
 {
-	uint8_t *n;
-	if (!(n = malloc(nsize)))
-		return;
+	uint64_t val;
+
+	if (unlikely(!bdecodevar(bp, &val))) {
+		bp->error = true;
+		return 0;
+	}
+	return val;
+}
 
-	p->size = nsize;
-	memcpy(n, p->data, p->wpos);
+int64_t bgetsvar(buffer_t *bp)
+{
+	uint64_t val = bgetvar(bp);
 
-	if (p->data)
-		free(p->data);
+	return (int64_t)(val >> 1) ^ -(int64_t)(val & 1);
+}
 
-	p->data = n;
-	memset(p->data, 0, p->size - p->wpos);
+const char *bgetstr(buffer_t *bp, size_t *len)
+{
+	size_t start = bp->rpos;
+	const char *ret;
+	uint64_t n;
+
+	/* Only this string's length counts, not earlier failed reads.  */
+	if (!bdecodevar(bp, &n)) {
+		bp->error = true;
+		*len = 0;
+		return NULL;
+	}
+	if (!bneed(bp, n)) {
+		bp->rpos = start;
+		*len = 0;
+		return NULL;
+	}
+
+	ret = (const char *)&bp->data[bp->rpos];
+	bp->rpos += n;
+	*len = n;
+	return ret;
 }
 
-uint32_t bget32(buffer_t *bp)
+/* Check for n * size overflows too.  */
+static bool bneed_array(buffer_t *bp, size_t n, size_t size)
 {
-	uint32_t tmp = unpack_u32(&bp->data[bp->rpos]);
-	bp->rpos += 4;
-	return tmp;
+	if (n > SIZE_MAX / size) {
+		bp->error = true;
+		return false;
+	}
+	return bneed(bp, n * size);
 }
 
-uint16_t bget16(buffer_t *bp)
+#ifdef HAVE_LITTLE_ENDIAN
+#define BGET_ARRAY(bp, vals, n, bits)	do {			\
+	memcpy(vals, &(bp)->data[(bp)->rpos], (n) * sizeof(*(vals)));	\
+	(bp)->rpos += (n) * sizeof(*(vals));			\
+} while (0)
+#else
+#define BGET_ARRAY(bp, vals, n, bits)	do {			\
+	size_t __i;						\
+	for (__i = 0; __i < (n); __i++)				\
+		(vals)[__i] = __bget##bits(bp);			\
+} while (0)
+#endif
+
+void bget16s(buffer_t *bp, uint16_t *vals, size_t n)
+{
+	if (bneed_array(bp, n, sizeof(*vals)))
+		BGET_ARRAY(bp, vals, n, 16);
+}
+
+void bget32s(buffer_t *bp, uint32_t *vals, size_t n)
 {
-	uint16_t tmp = unpack_u16(&bp->data[bp->rpos]);
-	bp->rpos += 2;
-	return tmp;
+	if (bneed_array(bp, n, sizeof(*vals)))
+		BGET_ARRAY(bp, vals, n, 32);
+}
+
+void bget64s(buffer_t *bp, uint64_t *vals, size_t n)
+{
+	if (bneed_array(bp, n, sizeof(*vals)))
+		BGET_ARRAY(bp, vals, n, 64);
 }
 
 uint8_t bgetc(buffer_t *bp)
 {
-	uint8_t tmp = bp->data[bp->rpos];
-	++bp->rpos;
-	return tmp;
+	return likely(bneed(bp, 1)) ? __bgetc(bp) : 0;
 }
 
-int btell(buffer_t *bp)
+size_t btell(buffer_t *bp)
 {
 	return bp->rpos;
 }
 
 void baddc(buffer_t *buffer, uint8_t byte)
 {
-	if (buffer->wpos+1 > buffer->size)
-		bresize(buffer, buffer->size + 1);
-
-	buffer->data[buffer->wpos] = byte;
-	++buffer->wpos;
+	bensure(buffer, 1);
+	__baddc(buffer, byte);
 }
 
 void badd16(buffer_t *buffer, uint16_t val)
 {
-	if (buffer->wpos + 2 > buffer->size)
-		bresize(buffer, buffer->size + 2);
-
-	pack_u16(&buffer->data[buffer->wpos], val);
-	buffer->wpos += 2;
+	bensure(buffer, 2);
+	__badd16(buffer, val);
 }
 
 void badd32(buffer_t *buffer, uint32_t val)
 {
-	if (buffer->wpos + 4 > buffer->size)
-		bresize(buffer, buffer->size + 4);
+	bensure(buffer, 4);
+	__badd32(buffer, val);
+}
+
+void badd64(buffer_t *buffer, uint64_t val)
+{
+	bensure(buffer, 8);
+	__badd64(buffer, val);
+}
+
+void baddfloat(buffer_t *buffer, float val)
+{
+	uint32_t tmp;
+
+	memcpy(&tmp, &val, sizeof(tmp));
+	badd32(buffer, tmp);
+}
+
+void badddouble(buffer_t *buffer, double val)
+{
+	uint64_t tmp;
+
+	memcpy(&tmp, &val, sizeof(tmp));
+	badd64(buffer, tmp);
+}
+
+void baddvar(buffer_t *buffer, uint64_t val)
+{
+	bensure(buffer, BVAR_MAX);
+	__baddvar(buffer, val);
+}
+
+void baddsvar(buffer_t *buffer, int64_t val)
+{
+	baddvar(buffer, ((uint64_t)val << 1) ^ (uint64_t)(val >> 63));
+}
+
+void baddbytes(buffer_t *buffer, const void *bytes, size_t size)
+{
+	bensure(buffer, size);
+	__baddbytes(buffer, bytes, size);
+}
+
+void baddstr(buffer_t *buffer, const char *str, size_t len)
+{
+	bensure(buffer, BVAR_MAX + len);
+	__baddvar(buffer, len);
+	__baddbytes(buffer, str, len);
+}
 
-	pack_u32(&buffer->data[buffer->wpos], val);
-	buffer->wpos += 4;
+#ifdef HAVE_LITTLE_ENDIAN
+#define BADD_ARRAY(bp, vals, n, bits)					\
+	baddbytes(bp, vals, (n) * sizeof(*(vals)))
+#else
+#define BADD_ARRAY(bp, vals, n, bits)	do {			\
+	size_t __i;						\
+	bensure(bp, (n) * sizeof(*(vals)));			\
+	for (__i = 0; __i < (n); __i++)				\
+		__badd##bits(bp, (vals)[__i]);			\
+} while (0)
+#endif
+
+void badd16s(buffer_t *bp, const uint16_t *vals, size_t n)
+{
+	BADD_ARRAY(bp, vals, n, 16);
 }
 
-void baddbytes(buffer_t *buffer, uint8_t *bytes, size_t size)
+void badd32s(buffer_t *bp, const uint32_t *vals, size_t n)
 {
-	size_t i;
-	if (buffer->wpos + size > buffer->size)
-		bresize(buffer, buffer->size + size);
+	BADD_ARRAY(bp, vals, n, 32);
+}
 
-	for (i = 0; i < size; ++i)
-		buffer->data[buffer->wpos++] = bytes[i];
+void badd64s(buffer_t *bp, const uint64_t *vals, size_t n)
+{
+	BADD_ARRAY(bp, vals, n, 64);
 }
 
 void bskip(buffer_t *buffer, int size)
 {
-	if (buffer->rpos + size > buffer->size)
+	if (size >= 0 ? !bneed(buffer, size) : (size_t)-size > buffer->rpos)
 		return;
 	buffer->rpos += size;
 }
 
 void bseek(buffer_t *buffer, int pos, bool move_readpos, seektype_t type)
 {
-	int *writePos;
+	size_t *writePos;
 	if (move_readpos)
 		writePos = &buffer->rpos;
 	else
@@ -137,11 +331,13 @@ void bseek(buffer_t *buffer, int pos, bool move_readpos, seektype_t type)
 
 	switch (type) {
 	case seek_start:
+		if (!move_readpos && pos > 0 && (size_t)pos > buffer->wpos)
+			bensure(buffer, pos - buffer->wpos);
 		*writePos = pos;
 		break;
 	case seek_curr:
-		if (!move_readpos && buffer->wpos + pos > buffer->size)
-			bresize(buffer, buffer->size + (pos * 2));
+		if (!move_readpos && pos > 0)
+			bensure(buffer, pos);
 		*writePos += pos;
 		break;
 	case seek_end:
@@ -150,7 +346,7 @@ void bseek(buffer_t *buffer, int pos, bool move_readpos, seektype_t type)
 	}
 }
 
-buffer_t *balloc(int bsize)
+buffer_t *balloc(size_t bsize)
 {
 	buffer_t *b;
 	if (!(b = malloc(sizeof(*b))))
@@ -162,6 +358,8 @@ buffer_t *balloc(int bsize)
 	memset(b->data, 0, bsize);
 	b->size  = bsize;
 	b->wpos  = b->rpos = 0;
+	b->mapped = false;
+	b->error = false;
 	return b;
 }
 
@@ -169,7 +367,7 @@ buffer_t* balloc_fp(const char* f)
 {
 	FILE *fp;
 	buffer_t *res;
-	int fsize;
+	size_t fsize;
 
 	if (!stat_file(f, &fsize))
 		return NULL;
@@ -190,10 +388,57 @@ buffer_t* balloc_fp(const char* f)
 		return NULL;
 	}
 
+	/* The file contents are the data written so far.  */
+	res->wpos = fsize;
+
 	fclose(fp);
 	return res;
 }
 
+buffer_t *balloc_mmap(const char *f, bool sequential)
+{
+#ifdef HAVE_MMAP
+	buffer_t *res;
+	struct stat st;
+	void *base;
+	int fd;
+
+	fd = open(f, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		return NULL;
+	}
+
+	/* Can't map an empty file.  */
+	if (st.st_size == 0) {
+		close(fd);
+		return balloc(BUFFER_MIN_SIZE);
+	}
+
+	base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED)
+		return NULL;
+	madvise(base, st.st_size, sequential ? MADV_SEQUENTIAL : MADV_WILLNEED);
+
+	if (!(res = malloc(sizeof(*res)))) {
+		munmap(base, st.st_size);
+		return NULL;
+	}
+
+	res->data = base;
+	res->size = res->wpos = st.st_size;
+	res->rpos = 0;
+	res->mapped = true;
+	res->error = false;
+	return res;
+#else
+	return balloc_fp(f);
+#endif
+}
+
 bool bwrite(buffer_t *buffer, const char *f)
 {
 	FILE *fp;
@@ -202,8 +447,10 @@ bool bwrite(buffer_t *buffer, const char *f)
 	if (!fp)
 		return false;
 
-	if (fwrite(buffer->data, 1, buffer->size, fp) != buffer->size)
+	if (fwrite(buffer->data, 1, buffer->wpos, fp) != buffer->wpos) {
+		fclose(fp);
 		return false;
+	}
 
 	/* Flush n close.  */
 	fclose(fp);
@@ -212,6 +459,11 @@ bool bwrite(buffer_t *buffer, const char *f)
 
 void bfree(buffer_t *buffer)
 {
+#ifdef HAVE_MMAP
+	if (buffer->mapped)
+		munmap(buffer->data, buffer->size);
+	else
+#endif
 	free(buffer->data);
 	free(buffer);
 }
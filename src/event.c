@@ -4,6 +4,7 @@
  */
 #include <csnippets/list.h>
 #include <csnippets/event.h>
+#include <csnippets/pool.h>
 
 #include <pthread.h>
 #include <time.h>
@@ -16,6 +17,8 @@ typedef struct event {
 	struct list_node node;
 } event_t;
 
+POOL_DEFINE_CACHED_TYPE(event_t, event);
+
 static pthread_mutex_t mutex        = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t  cond         = PTHREAD_COND_INITIALIZER;
 static bool            running = false;
@@ -53,7 +56,7 @@ static void *events_thread(void __unused *unused)
 		pthread_mutex_unlock(&mutex);
 
 		tasks_add(event->task);
-		free(event);
+		event_free(event);
 	}
 
 	/* if we have any remaining events, add them to tasks  */
@@ -63,7 +66,7 @@ static void *events_thread(void __unused *unused)
 		pthread_mutex_unlock(&mutex);
 
 		tasks_add(event->task);
-		free(event);
+		event_free(event);
 	}
 
 	return NULL;
@@ -106,12 +109,14 @@ event_t *event_create(int delay, task_routine start, void *p)
 	if (!start || delay < 0)
 		return NULL;
 
-	xmalloc(event, sizeof(event_t), return NULL);
+	event = event_alloc();
+	if (!event)
+		return NULL;
 	event->delay = delay;
 	event->task = task_create(start, p);
 
 	if (!event->task) {
-		free(event);
+		event_free(event);
 		return NULL;
 	}
 
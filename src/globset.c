@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2013 Ahmed Samy  <f.fallen45@gmail.com>
+ * Licensed under MIT, see LICENSE.MIT for details.
+ */
+#include <csnippets/globset.h>
+
+#include <ctype.h>
+
+/*
+ * A pattern with n characters besides the stars has states 0..n, state
+ * i meaning "the first i characters matched".  A star is a loop on the
+ * state it comes after.  The states of all the patterns are bits in one
+ * vector D, pattern after pattern, and each input byte c does:
+ *
+ *	D = ((D & A[c]) << 1) | (D & L)
+ *
+ * where A[c] has the states whose next character matches c, and L those
+ * with a star.  The last state of a pattern is never in A, so nothing is
+ * shifted into the next pattern.  A pattern matched if its last state is
+ * set at the end.
+ *
+ * Bytes that appear in no pattern all behave the same, so A only has a
+ * row per distinct (folded) pattern byte, plus one for all the others.
+ */
+#define GLOBSET_STACK_WORDS	64
+
+struct globpat {
+	char *pattern;
+	int id;
+};
+
+struct globset {
+	struct globpat *pats;
+	size_t npats, cap;
+
+	bool compiled;
+	size_t nwords;
+	uint16_t class[256];	/* input byte -> row of trans */
+	uint64_t *trans;	/* A[], nclasses rows of nwords */
+	uint64_t *init, *loop, *final;
+	int *final_pat;		/* state bit -> pattern, for final states */
+};
+
+static void globset_reset(globset_t *g)
+{
+	free(g->trans);
+	free(g->init);
+	free(g->loop);
+	free(g->final);
+	free(g->final_pat);
+	g->trans = g->init = g->loop = g->final = NULL;
+	g->final_pat = NULL;
+	g->compiled = false;
+}
+
+globset_t *globset_new(void)
+{
+	globset_t *g;
+
+	xmalloc(g, sizeof(*g), return NULL);
+	return g;
+}
+
+void globset_free(globset_t *g)
+{
+	size_t i;
+
+	if (!g)
+		return;
+
+	for (i = 0; i < g->npats; i++)
+		free(g->pats[i].pattern);
+	free(g->pats);
+	globset_reset(g);
+	free(g);
+}
+
+bool globset_add(globset_t *g, const char *pattern, int id)
+{
+	struct globpat *p;
+	char *copy;
+
+	if (g->npats == g->cap) {
+		size_t ncap = g->cap ? g->cap * 2 : 16;
+
+		p = realloc(g->pats, ncap * sizeof(*p));
+		if (!p)
+			return false;
+		g->pats = p;
+		g->cap = ncap;
+	}
+
+	if (!(copy = strdup(pattern)))
+		return false;
+
+	g->pats[g->npats].pattern = copy;
+	g->pats[g->npats].id = id;
+	g->npats++;
+	g->compiled = false;
+	return true;
+}
+
+static inline void set_bit(uint64_t *v, size_t bit)
+{
+	v[bit / 64] |= 1ULL << (bit % 64);
+}
+
+bool globset_compile(globset_t *g)
+{
+	uint16_t folded[256] = { 0 };
+	uint8_t upper[256];
+	size_t nbits = 0, bit, i, nclasses = 1;
+	const char *s;
+	int c;
+
+	globset_reset(g);
+
+	/* Give every folded byte used in a pattern its own row.  */
+	for (c = 0; c < 256; c++)
+		upper[c] = toupper(c);
+	for (i = 0; i < g->npats; i++) {
+		for (s = g->pats[i].pattern; *s; s++) {
+			if (*s == '*')
+				continue;
+			nbits++;
+			if (*s == '?')
+				continue;
+			c = upper[(uint8_t)*s];
+			if (!folded[c])
+				folded[c] = nclasses++;
+		}
+		nbits++;	/* the start state */
+	}
+	for (c = 0; c < 256; c++)
+		g->class[c] = folded[upper[c]];
+
+	g->nwords = (nbits + 63) / 64;
+	g->trans = calloc(nclasses * g->nwords, sizeof(uint64_t));
+	g->init = calloc(g->nwords, sizeof(uint64_t));
+	g->loop = calloc(g->nwords, sizeof(uint64_t));
+	g->final = calloc(g->nwords, sizeof(uint64_t));
+	g->final_pat = malloc((nbits ? nbits : 1) * sizeof(int));
+	if (!g->trans || !g->init || !g->loop || !g->final || !g->final_pat) {
+		globset_reset(g);
+		return false;
+	}
+
+	for (i = 0, bit = 0; i < g->npats; i++, bit++) {
+		set_bit(g->init, bit);
+		for (s = g->pats[i].pattern; *s; s++) {
+			if (*s == '*') {
+				set_bit(g->loop, bit);
+				continue;
+			}
+
+			if (*s == '?') {
+				for (c = 0; c < (int)nclasses; c++)
+					set_bit(&g->trans[c * g->nwords], bit);
+			} else
+				set_bit(&g->trans[g->class[(uint8_t)*s] * g->nwords], bit);
+			bit++;
+		}
+		set_bit(g->final, bit);
+		g->final_pat[bit] = i;
+	}
+
+	g->compiled = true;
+	return true;
+}
+
+int globset_matchn(const globset_t *g, const char *str, size_t len,
+		   int *ids, int max)
+{
+	uint64_t stack[GLOBSET_STACK_WORDS], *d = stack, carry, x, any, m;
+	const uint8_t *s = (const uint8_t *)str, *end = s + len;
+	const uint64_t *a;
+	size_t w, nw = g->nwords;
+	int n = 0;
+
+	/* Never report "no match" when we can't tell.  */
+	if (!g->compiled)
+		return -1;
+	if (!g->npats)
+		return 0;
+
+	if (nw > GLOBSET_STACK_WORDS && !(d = malloc(nw * sizeof(*d))))
+		return -1;
+	memcpy(d, g->init, nw * sizeof(*d));
+
+	for (; s < end; s++) {
+		a = &g->trans[g->class[*s] * nw];
+		carry = any = 0;
+		for (w = 0; w < nw; w++) {
+			x = d[w] & a[w];
+			d[w] = (x << 1) | carry | (d[w] & g->loop[w]);
+			carry = x >> 63;
+			any |= d[w];
+		}
+
+		/* Nothing left alive, no pattern can match.  */
+		if (!any)
+			goto out;
+	}
+
+	for (w = 0; w < nw; w++) {
+		for (m = d[w] & g->final[w]; m; m &= m - 1) {
+			if (n < max)
+				ids[n] = g->pats[g->final_pat[w * 64 + __builtin_ctzll(m)]].id;
+			n++;
+		}
+	}
+
+out:
+	if (d != stack)
+		free(d);
+	return n;
+}
+
+int globset_match(const globset_t *g, const char *str, int *ids, int max)
+{
+	return globset_matchn(g, str, strlen(str), ids, max);
+}
@@ -5,8 +5,8 @@ lookup3.c, by Bob Jenkins, May 2006, Public Domain.
 
 These are functions for producing 32-bit hashes for hash table lookup.
 hash_word(), hashlittle(), hashlittle2(), hashbig(), mix(), and final() 
-are externally useful functions.  Routines to test the hash are included 
-if SELF_TEST is defined.  You can use this free for any purpose.  It's in
+are externally useful functions.  The benchmark and quality checks live
+in examples/hashbench.  You can use this free for any purpose.  It's in
 the public domain.  It has no warranty.
 
 You probably want to use hashlittle().  hashlittle() and hashbig()
@@ -34,39 +34,6 @@ mixing with 12*3 instructions on 3 integers than you can with 3 instructions
 on 1 byte), but shoehorning those bytes into integers efficiently is messy.
 -------------------------------------------------------------------------------
 */
-//#define SELF_TEST 1
-
-#if 0
-#include <stdio.h>      /* defines printf for tests */
-#include <time.h>       /* defines time_t for timings in the test */
-#include <stdint.h>     /* defines uint32_t etc */
-#include <sys/param.h>  /* attempt to define endianness */
-
-#ifdef linux
-# include <endian.h>    /* attempt to define endianness */
-#endif
-
-/*
- * My best guess at if you are big-endian or little-endian.  This may
- * need adjustment.
- */
-#if (defined(__BYTE_ORDER) && defined(__LITTLE_ENDIAN) && \
-     __BYTE_ORDER == __LITTLE_ENDIAN) || \
-    (defined(i386) || defined(__i386__) || defined(__i486__) || \
-     defined(__i586__) || defined(__i686__) || defined(__x86_64) || \
-     defined(vax) || defined(MIPSEL))
-# define HASH_LITTLE_ENDIAN 1
-# define HASH_BIG_ENDIAN 0
-#elif (defined(__BYTE_ORDER) && defined(__BIG_ENDIAN) && \
-       __BYTE_ORDER == __BIG_ENDIAN) || \
-      (defined(sparc) || defined(POWERPC) || defined(mc68000) || defined(sel))
-# define HASH_LITTLE_ENDIAN 0
-# define HASH_BIG_ENDIAN 1
-#else
-# error Unknown endian
-#endif
-#endif /* old hash.c headers. */
-
 #include <csnippets/hash.h>
 
 #if HAVE_LITTLE_ENDIAN
@@ -711,216 +678,511 @@ uint64_t hash64_any(const void *key, size_t length, uint64_t base)
 	return ((uint64_t)b32 << 32) | lower;
 }
 
-#ifdef SELF_TEST
+/*
+ * Streaming lookup3.
+ *
+ * The state is the (a,b,c) triple plus up to 12 bytes that haven't been
+ * mixed yet.  A block is only mixed once we know more data follows it,
+ * since the last block goes through final() instead of mix().  Words are
+ * assembled bytewise in the same order hashlittle() (or hashbig()) reads
+ * them, and the last block is zero padded just like their switch(), so
+ * the results match hash_any() and hash64_any() exactly.
+ */
+static inline uint32_t stream_word(const uint8_t *k)
+{
+	if (HASH_BIG_ENDIAN)
+		return (uint32_t)k[0] << 24 | (uint32_t)k[1] << 16
+			| (uint32_t)k[2] << 8 | k[3];
+	return k[0] | (uint32_t)k[1] << 8 | (uint32_t)k[2] << 16
+		| (uint32_t)k[3] << 24;
+}
 
-/* used for timings */
-void driver1()
+static inline void stream_block(struct hash_state *st, const uint8_t *k)
 {
-  uint8_t buf[256];
-  uint32_t i;
-  uint32_t h=0;
-  time_t a,z;
+	uint32_t a = st->a, b = st->b, c = st->c;
+
+	a += stream_word(k);
+	b += stream_word(k + 4);
+	c += stream_word(k + 8);
+	mix(a,b,c);
+	st->a = a;
+	st->b = b;
+	st->c = c;
+}
 
-  time(&a);
-  for (i=0; i<256; ++i) buf[i] = 'x';
-  for (i=0; i<1; ++i) 
-  {
-    h = hashlittle(&buf[0],1,h);
-  }
-  time(&z);
-  if (z-a > 0) printf("time %d %.8x\n", z-a, h);
+/* Returns c, stores b in *val2 (untouched for an empty key).  */
+static uint32_t stream_final(const struct hash_state *st, uint32_t *val2)
+{
+	uint32_t a = st->a, b = st->b, c = st->c;
+	uint8_t k[12] = { 0 };
+
+	assert(st->seen == st->length);
+	if (st->length == 0)
+		return c;
+
+	memcpy(k, st->buf, st->pending);
+	a += stream_word(k);
+	b += stream_word(k + 4);
+	c += stream_word(k + 8);
+	final(a,b,c);
+	*val2 = b;
+	return c;
 }
 
-/* check that every input bit changes every output bit half the time */
-#define HASHSTATE 1
-#define HASHLEN   1
-#define MAXPAIR 60
-#define MAXLEN  70
-void driver2()
+void hash_any_init(struct hash_state *st, size_t length, uint32_t base)
 {
-  uint8_t qa[MAXLEN+1], qb[MAXLEN+2], *a = &qa[0], *b = &qb[1];
-  uint32_t c[HASHSTATE], d[HASHSTATE], i=0, j=0, k, l, m=0, z;
-  uint32_t e[HASHSTATE],f[HASHSTATE],g[HASHSTATE],h[HASHSTATE];
-  uint32_t x[HASHSTATE],y[HASHSTATE];
-  uint32_t hlen;
+	st->a = st->b = st->c = 0xdeadbeef + ((uint32_t)length) + base;
+	st->base = base;
+	st->length = length;
+	st->seen = 0;
+	st->pending = 0;
+}
 
-  printf("No more than %d trials should ever be needed \n",MAXPAIR/2);
-  for (hlen=0; hlen < MAXLEN; ++hlen)
-  {
-    z=0;
-    for (i=0; i<hlen; ++i)  /*----------------------- for each input byte, */
-    {
-      for (j=0; j<8; ++j)   /*------------------------ for each input bit, */
-      {
-	for (m=1; m<8; ++m) /*------------ for several possible initvals, */
-	{
-	  for (l=0; l<HASHSTATE; ++l)
-	    e[l]=f[l]=g[l]=h[l]=x[l]=y[l]=~((uint32_t)0);
-
-      	  /*---- check that every output bit is affected by that input bit */
-	  for (k=0; k<MAXPAIR; k+=2)
-	  { 
-	    uint32_t finished=1;
-	    /* keys have one bit different */
-	    for (l=0; l<hlen+1; ++l) {a[l] = b[l] = (uint8_t)0;}
-	    /* have a and b be two keys differing in only one bit */
-	    a[i] ^= (k<<j);
-	    a[i] ^= (k>>(8-j));
-	     c[0] = hashlittle(a, hlen, m);
-	    b[i] ^= ((k+1)<<j);
-	    b[i] ^= ((k+1)>>(8-j));
-	     d[0] = hashlittle(b, hlen, m);
-	    /* check every bit is 1, 0, set, and not set at least once */
-	    for (l=0; l<HASHSTATE; ++l)
-	    {
-	      e[l] &= (c[l]^d[l]);
-	      f[l] &= ~(c[l]^d[l]);
-	      g[l] &= c[l];
-	      h[l] &= ~c[l];
-	      x[l] &= d[l];
-	      y[l] &= ~d[l];
-	      if (e[l]|f[l]|g[l]|h[l]|x[l]|y[l]) finished=0;
-	    }
-	    if (finished) break;
-	  }
-	  if (k>z) z=k;
-	  if (k==MAXPAIR) 
-	  {
-	     printf("Some bit didn't change: ");
-	     printf("%.8x %.8x %.8x %.8x %.8x %.8x  ",
-	            e[0],f[0],g[0],h[0],x[0],y[0]);
-	     printf("i %d j %d m %d len %d\n", i, j, m, hlen);
-	  }
-	  if (z==MAXPAIR) goto done;
+void hash_any_update(struct hash_state *st, const void *data, size_t len)
+{
+	const uint8_t *p = data;
+
+	st->seen += len;
+	if (st->pending) {
+		size_t fill = 12 - st->pending;
+
+		if (len <= fill) {
+			memcpy(st->buf + st->pending, p, len);
+			st->pending += len;
+			return;
+		}
+
+		memcpy(st->buf + st->pending, p, fill);
+		p += fill;
+		len -= fill;
+		stream_block(st, st->buf);
 	}
-      }
-    }
-   done:
-    if (z < MAXPAIR)
-    {
-      printf("Mix success  %2d bytes  %2d initvals  ",i,m);
-      printf("required  %d  trials\n", z/2);
-    }
-  }
-  printf("\n");
-}
-
-/* Check for reading beyond the end of the buffer and alignment problems */
-void driver3()
-{
-  uint8_t buf[MAXLEN+20], *b;
-  uint32_t len;
-  uint8_t q[] = "This is the time for all good men to come to the aid of their country...";
-  uint32_t h;
-  uint8_t qq[] = "xThis is the time for all good men to come to the aid of their country...";
-  uint32_t i;
-  uint8_t qqq[] = "xxThis is the time for all good men to come to the aid of their country...";
-  uint32_t j;
-  uint8_t qqqq[] = "xxxThis is the time for all good men to come to the aid of their country...";
-  uint32_t ref,x,y;
-  uint8_t *p;
-
-  printf("Endianness.  These lines should all be the same (for values filled in):\n");
-  printf("%.8x                            %.8x                            %.8x\n",
-         hash_word((const uint32_t *)q, (sizeof(q)-1)/4, 13),
-         hash_word((const uint32_t *)q, (sizeof(q)-5)/4, 13),
-         hash_word((const uint32_t *)q, (sizeof(q)-9)/4, 13));
-  p = q;
-  printf("%.8x %.8x %.8x %.8x %.8x %.8x %.8x %.8x %.8x %.8x %.8x %.8x\n",
-         hashlittle(p, sizeof(q)-1, 13), hashlittle(p, sizeof(q)-2, 13),
-         hashlittle(p, sizeof(q)-3, 13), hashlittle(p, sizeof(q)-4, 13),
-         hashlittle(p, sizeof(q)-5, 13), hashlittle(p, sizeof(q)-6, 13),
-         hashlittle(p, sizeof(q)-7, 13), hashlittle(p, sizeof(q)-8, 13),
-         hashlittle(p, sizeof(q)-9, 13), hashlittle(p, sizeof(q)-10, 13),
-         hashlittle(p, sizeof(q)-11, 13), hashlittle(p, sizeof(q)-12, 13));
-  p = &qq[1];
-  printf("%.8x %.8x %.8x %.8x %.8x %.8x %.8x %.8x %.8x %.8x %.8x %.8x\n",
-         hashlittle(p, sizeof(q)-1, 13), hashlittle(p, sizeof(q)-2, 13),
-         hashlittle(p, sizeof(q)-3, 13), hashlittle(p, sizeof(q)-4, 13),
-         hashlittle(p, sizeof(q)-5, 13), hashlittle(p, sizeof(q)-6, 13),
-         hashlittle(p, sizeof(q)-7, 13), hashlittle(p, sizeof(q)-8, 13),
-         hashlittle(p, sizeof(q)-9, 13), hashlittle(p, sizeof(q)-10, 13),
-         hashlittle(p, sizeof(q)-11, 13), hashlittle(p, sizeof(q)-12, 13));
-  p = &qqq[2];
-  printf("%.8x %.8x %.8x %.8x %.8x %.8x %.8x %.8x %.8x %.8x %.8x %.8x\n",
-         hashlittle(p, sizeof(q)-1, 13), hashlittle(p, sizeof(q)-2, 13),
-         hashlittle(p, sizeof(q)-3, 13), hashlittle(p, sizeof(q)-4, 13),
-         hashlittle(p, sizeof(q)-5, 13), hashlittle(p, sizeof(q)-6, 13),
-         hashlittle(p, sizeof(q)-7, 13), hashlittle(p, sizeof(q)-8, 13),
-         hashlittle(p, sizeof(q)-9, 13), hashlittle(p, sizeof(q)-10, 13),
-         hashlittle(p, sizeof(q)-11, 13), hashlittle(p, sizeof(q)-12, 13));
-  p = &qqqq[3];
-  printf("%.8x %.8x %.8x %.8x %.8x %.8x %.8x %.8x %.8x %.8x %.8x %.8x\n",
-         hashlittle(p, sizeof(q)-1, 13), hashlittle(p, sizeof(q)-2, 13),
-         hashlittle(p, sizeof(q)-3, 13), hashlittle(p, sizeof(q)-4, 13),
-         hashlittle(p, sizeof(q)-5, 13), hashlittle(p, sizeof(q)-6, 13),
-         hashlittle(p, sizeof(q)-7, 13), hashlittle(p, sizeof(q)-8, 13),
-         hashlittle(p, sizeof(q)-9, 13), hashlittle(p, sizeof(q)-10, 13),
-         hashlittle(p, sizeof(q)-11, 13), hashlittle(p, sizeof(q)-12, 13));
-  printf("\n");
-
-  /* check that hashlittle2 and hashlittle produce the same results */
-  i=47; j=0;
-  hashlittle2(q, sizeof(q), &i, &j);
-  if (hashlittle(q, sizeof(q), 47) != i)
-    printf("hashlittle2 and hashlittle mismatch\n");
-
-  /* check that hash_word2 and hash_word produce the same results */
-  len = 0xdeadbeef;
-  i=47, j=0;
-  hash_word2(&len, 1, &i, &j);
-  if (hash_word(&len, 1, 47) != i)
-    printf("hash_word2 and hash_word mismatch %x %x\n", 
-	   i, hash_word(&len, 1, 47));
-
-  /* check hashlittle doesn't read before or after the ends of the string */
-  for (h=0, b=buf+1; h<8; ++h, ++b)
-  {
-    for (i=0; i<MAXLEN; ++i)
-    {
-      len = i;
-      for (j=0; j<i; ++j) *(b+j)=0;
-
-      /* these should all be equal */
-      ref = hashlittle(b, len, (uint32_t)1);
-      *(b+i)=(uint8_t)~0;
-      *(b-1)=(uint8_t)~0;
-      x = hashlittle(b, len, (uint32_t)1);
-      y = hashlittle(b, len, (uint32_t)1);
-      if ((ref != x) || (ref != y)) 
-      {
-	printf("alignment error: %.8x %.8x %.8x %d %d\n",ref,x,y,
-               h, i);
-      }
-    }
-  }
+
+	while (len > 12) {
+		stream_block(st, p);
+		p += 12;
+		len -= 12;
+	}
+
+	memcpy(st->buf, p, len);
+	st->pending = len;
 }
 
-/* check for problems with nulls */
- void driver4()
+uint32_t hash_any_final(const struct hash_state *st)
 {
-  uint8_t buf[1];
-  uint32_t h,i,state[HASHSTATE];
+	uint32_t b = st->base;
 
+	return stream_final(st, &b);
+}
 
-  buf[0] = ~0;
-  for (i=0; i<HASHSTATE; ++i) state[i] = 1;
-  printf("These should all be different\n");
-  for (i=0, h=0; i<8; ++i)
-  {
-    h = hashlittle(buf, 0, h);
-    printf("%2ld  0-byte strings, hash is  %.8x\n", i, h);
-  }
+void hash64_any_init(struct hash_state *st, size_t length, uint64_t base)
+{
+	hash_any_init(st, length, base + (base >> 32));
+}
+
+uint64_t hash64_any_final(const struct hash_state *st)
+{
+	uint32_t b = st->base;
+	uint32_t lower = stream_final(st, &b);
+
+	return ((uint64_t)b << 32) | lower;
 }
 
+/*
+ * Bulk hashing.
+ *
+ * lookup3 only uses 32-bit add, sub, xor and rotates, so several keys can
+ * be pushed through mix() and final() at once, one key per SIMD lane.  The
+ * operations are exactly those of hashlittle() and hash_u32(), so the
+ * results are bit-identical to the one-at-a-time functions.
+ *
+ * We use GCC's generic vectors: they are lowered to SSE2/AVX2 (or NEON,
+ * ...) and to plain scalar code where there's no SIMD unit at all.
+ * __simd_clones builds an AVX2 version next to the default one.
+ */
+#if (defined __GNUC__ || defined __clang__) && HASH_LITTLE_ENDIAN
+#define HASH_LANES 8
+typedef uint32_t hash_vec __attribute__((vector_size(HASH_LANES * sizeof(uint32_t))));
+
+/* Functions can't take or return hash_vec without changing the ABI when
+ * AVX is off, so this is a macro.  */
+#define vec_splat(v, x) do {				\
+		int __i;				\
+		for (__i = 0; __i < HASH_LANES; __i++)	\
+			(v)[__i] = (x);			\
+	} while (0)
+
+static inline uint32_t get_u32(const uint8_t *p)
+{
+	uint32_t v;
+	memcpy(&v, p, 4);
+	return v;
+}
 
-int main()
+/* The first @n bytes at @p as a little-endian word, zero padded.  */
+static inline uint32_t get_partial(const uint8_t *p, size_t n)
 {
-  driver1();   /* test that the key is hashed: used for timings */
-  driver2();   /* test that whole key is hashed thoroughly */
-  driver3();   /* test that nothing but the key is hashed */
-  driver4();   /* test hashing multiple buffers (all buffers are null) */
-  return 1;
+	switch (n) {
+	case 0: return 0;
+	case 1: return p[0];
+	case 2: return p[0] | (uint32_t)p[1] << 8;
+	case 3: return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16;
+	default: return get_u32(p);
+	}
 }
 
-#endif  /* SELF_TEST */
+/* hashlittle() of HASH_LANES keys of the same length, stores c in @hc
+ * and b in @hb (as hashlittle() does with *val2).  */
+static __simd_clones void hashlittle_lanes(const uint8_t *const *k, size_t length,
+					   uint32_t initval, uint32_t *hc,
+					   uint32_t *hb)
+{
+	hash_vec a, b, c, x, y, z;
+	size_t off = 0, rem;
+	int l;
+
+	vec_splat(a, 0xdeadbeef + (uint32_t)length + initval);
+	b = c = a;
+	if (length == 0) {
+		memcpy(hc, &c, sizeof(c));
+		for (l = 0; l < HASH_LANES; l++)
+			hb[l] = initval;
+		return;
+	}
+
+	while (length - off > 12) {
+		for (l = 0; l < HASH_LANES; l++) {
+			x[l] = get_u32(k[l] + off);
+			y[l] = get_u32(k[l] + off + 4);
+			z[l] = get_u32(k[l] + off + 8);
+		}
+		a += x;
+		b += y;
+		c += z;
+		mix(a,b,c);
+		off += 12;
+	}
+
+	/* The last 1..12 bytes, zero padded, just like the switch in
+	 * hashlittle().  */
+	rem = length - off;
+	for (l = 0; l < HASH_LANES; l++) {
+		x[l] = get_partial(k[l] + off, rem);
+		y[l] = rem > 4 ? get_partial(k[l] + off + 4, rem - 4) : 0;
+		z[l] = rem > 8 ? get_partial(k[l] + off + 8, rem - 8) : 0;
+	}
+	a += x;
+	b += y;
+	c += z;
+	final(a,b,c);
+
+	memcpy(hc, &c, sizeof(c));
+	memcpy(hb, &b, sizeof(b));
+}
+
+/* hash_u32() of HASH_LANES consecutive keys of @num words each.  */
+static __simd_clones void hash_u32_lanes(const uint32_t *k, size_t num,
+					 uint32_t initval, uint32_t *out)
+{
+	size_t length = num, off = 0;
+	hash_vec a, b, c, x, y, z;
+	int l;
+
+	vec_splat(a, 0xdeadbeef + (((uint32_t)num)<<2) + initval);
+	b = c = a;
+	while (length > 3) {
+		for (l = 0; l < HASH_LANES; l++) {
+			x[l] = k[l * num + off];
+			y[l] = k[l * num + off + 1];
+			z[l] = k[l * num + off + 2];
+		}
+		a += x;
+		b += y;
+		c += z;
+		mix(a,b,c);
+		length -= 3;
+		off += 3;
+	}
+
+	if (length) {
+		for (l = 0; l < HASH_LANES; l++) {
+			x[l] = k[l * num + off];
+			y[l] = length > 1 ? k[l * num + off + 1] : 0;
+			z[l] = length > 2 ? k[l * num + off + 2] : 0;
+		}
+		a += x;
+		b += y;
+		c += z;
+		final(a,b,c);
+	}
+
+	memcpy(out, &c, sizeof(c));
+}
+
+static inline bool same_lengths(const size_t *lengths)
+{
+	int l;
+
+	for (l = 1; l < HASH_LANES; l++)
+		if (lengths[l] != lengths[0])
+			return false;
+	return true;
+}
+#else
+#define HASH_LANES 0
+#endif
+
+void hash_u32_many(const uint32_t *keys, size_t num, size_t count,
+		   uint32_t base, uint32_t *hashes)
+{
+	size_t i = 0;
+
+#if HASH_LANES
+	for (; i + HASH_LANES <= count; i += HASH_LANES)
+		hash_u32_lanes(keys + i * num, num, base, hashes + i);
+#endif
+	for (; i < count; i++)
+		hashes[i] = hash_u32(keys + i * num, num, base);
+}
+
+void hash_any_many(const void *const *keys, const size_t *lengths,
+		   size_t count, uint32_t base, uint32_t *hashes)
+{
+	size_t i = 0;
+
+#if HASH_LANES
+	uint32_t hb[HASH_LANES];
+
+	for (; i + HASH_LANES <= count; i += HASH_LANES) {
+		if (same_lengths(lengths + i))
+			hashlittle_lanes((const uint8_t *const *)keys + i,
+					 lengths[i], base, hashes + i, hb);
+		else {
+			size_t j;
+
+			for (j = i; j < i + HASH_LANES; j++)
+				hashes[j] = hash_any(keys[j], lengths[j], base);
+		}
+	}
+#endif
+	for (; i < count; i++)
+		hashes[i] = hash_any(keys[i], lengths[i], base);
+}
+
+void hash64_any_many(const void *const *keys, const size_t *lengths,
+		     size_t count, uint64_t base, uint64_t *hashes)
+{
+	size_t i = 0;
+
+#if HASH_LANES
+	uint32_t b32 = base + (base >> 32);
+	uint32_t hc[HASH_LANES], hb[HASH_LANES];
+
+	for (; i + HASH_LANES <= count; i += HASH_LANES) {
+		size_t j;
+
+		if (same_lengths(lengths + i)) {
+			hashlittle_lanes((const uint8_t *const *)keys + i,
+					 lengths[i], b32, hc, hb);
+			for (j = 0; j < HASH_LANES; j++)
+				hashes[i + j] = ((uint64_t)hb[j] << 32) | hc[j];
+		} else {
+			for (j = i; j < i + HASH_LANES; j++)
+				hashes[j] = hash64_any(keys[j], lengths[j], base);
+		}
+	}
+#endif
+	for (; i < count; i++)
+		hashes[i] = hash64_any(keys[i], lengths[i], base);
+}
+
+/*
+ * hash64_fast: a wyhash-style hash (Wang Yi's wyhash, final version 4).
+ *
+ * Everything is built on mum(): a 64x64->128 bit multiply whose halves
+ * are xored.  Keys of up to 16 bytes are read as two (overlapping) words,
+ * longer ones are consumed 16 bytes per mum() and, above 48 bytes, in
+ * three independent chains so the multiplier stays busy.  The last 16
+ * bytes of the key are always read as a whole, overlapping the previous
+ * block if needed, which the streaming state has to remember.
+ */
+static const uint64_t fast_secret[4] = {
+	0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull,
+	0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull
+};
+
+static inline void fast_mum(uint64_t *a, uint64_t *b)
+{
+#ifdef __SIZEOF_INT128__
+	__uint128_t r = *a;
+
+	r *= *b;
+	*a = (uint64_t)r;
+	*b = (uint64_t)(r >> 64);
+#else
+	uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+	uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	uint64_t t = rl + (rm0 << 32), c = t < rl, lo;
+
+	lo = t + (rm1 << 32);
+	c += lo < t;
+	*a = lo;
+	*b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline uint64_t fast_mix(uint64_t a, uint64_t b)
+{
+	fast_mum(&a, &b);
+	return a ^ b;
+}
+
+static inline uint64_t fast_r8(const uint8_t *p)
+{
+	uint64_t v;
+	memcpy(&v, p, 8);
+	return v;
+}
+
+static inline uint64_t fast_r4(const uint8_t *p)
+{
+	uint32_t v;
+	memcpy(&v, p, 4);
+	return v;
+}
+
+static inline uint64_t fast_seed(uint64_t base)
+{
+	return base ^ fast_mix(base ^ fast_secret[0], fast_secret[1]);
+}
+
+/* One 48-byte block of the three-chain loop.  */
+static inline void fast_block(const uint8_t *p, uint64_t *seed,
+			      uint64_t *see1, uint64_t *see2)
+{
+	*seed = fast_mix(fast_r8(p) ^ fast_secret[1], fast_r8(p + 8) ^ *seed);
+	*see1 = fast_mix(fast_r8(p + 16) ^ fast_secret[2], fast_r8(p + 24) ^ *see1);
+	*see2 = fast_mix(fast_r8(p + 32) ^ fast_secret[3], fast_r8(p + 40) ^ *see2);
+}
+
+static inline uint64_t fast_finish(uint64_t a, uint64_t b, uint64_t seed,
+				   uint64_t length)
+{
+	a ^= fast_secret[1];
+	b ^= seed;
+	fast_mum(&a, &b);
+	return fast_mix(a ^ fast_secret[0] ^ length, b ^ fast_secret[1]);
+}
+
+/* Keys of 0..16 bytes.  */
+static inline uint64_t fast_short(const uint8_t *p, size_t len, uint64_t seed)
+{
+	uint64_t a, b;
+
+	if (likely(len >= 4)) {
+		size_t mid = (len >> 3) << 2;
+
+		a = (fast_r4(p) << 32) | fast_r4(p + mid);
+		b = (fast_r4(p + len - 4) << 32) | fast_r4(p + len - 4 - mid);
+	} else if (len > 0) {
+		a = ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+		b = 0;
+	} else
+		a = b = 0;
+
+	return fast_finish(a, b, seed, len);
+}
+
+/* The last @i (> 0) bytes at @p of a key of @length (> 16) bytes, the 16
+ * bytes before @p must be readable.  */
+static inline uint64_t fast_tail(const uint8_t *p, size_t i, uint64_t seed,
+				 uint64_t length)
+{
+	while (i > 16) {
+		seed = fast_mix(fast_r8(p) ^ fast_secret[1], fast_r8(p + 8) ^ seed);
+		i -= 16;
+		p += 16;
+	}
+
+	return fast_finish(fast_r8(p + i - 16), fast_r8(p + i - 8), seed, length);
+}
+
+uint64_t hash64_fast_any(const void *key, size_t length, uint64_t base)
+{
+	const uint8_t *p = key;
+	uint64_t seed = fast_seed(base);
+	size_t i = length;
+
+	if (length <= 16)
+		return fast_short(p, length, seed);
+
+	if (unlikely(i > 48)) {
+		uint64_t see1 = seed, see2 = seed;
+
+		do {
+			fast_block(p, &seed, &see1, &see2);
+			p += 48;
+			i -= 48;
+		} while (likely(i > 48));
+		seed ^= see1 ^ see2;
+	}
+
+	return fast_tail(p, i, seed, length);
+}
+
+void hash64_fast_init(struct hash64_fast_state *st, uint64_t base)
+{
+	st->seed = st->see1 = st->see2 = fast_seed(base);
+	st->total = 0;
+	st->pending = 0;
+}
+
+void hash64_fast_update(struct hash64_fast_state *st, const void *data, size_t len)
+{
+	const uint8_t *p = data;
+	uint8_t *pend = st->buf + 16;
+
+	st->total += len;
+	if (st->pending + len <= 48) {
+		memcpy(pend + st->pending, p, len);
+		st->pending += len;
+		return;
+	}
+
+	/* More than 48 bytes: at least one block can go, and some input
+	 * is left over for the tail, as in hash64_fast_any().  */
+	if (st->pending) {
+		size_t fill = 48 - st->pending;
+
+		memcpy(pend + st->pending, p, fill);
+		p += fill;
+		len -= fill;
+		fast_block(pend, &st->seed, &st->see1, &st->see2);
+		memcpy(st->buf, st->buf + 48, 16);
+	}
+
+	if (len > 48) {
+		do {
+			fast_block(p, &st->seed, &st->see1, &st->see2);
+			p += 48;
+			len -= 48;
+		} while (len > 48);
+		memcpy(st->buf, p - 16, 16);
+	}
+
+	memcpy(pend, p, len);
+	st->pending = len;
+}
+
+uint64_t hash64_fast_final(const struct hash64_fast_state *st)
+{
+	const uint8_t *pend = st->buf + 16;
+
+	if (st->total <= 16)
+		return fast_short(pend, st->total, st->seed);
+	if (st->total <= 48)
+		return fast_tail(pend, st->pending, st->seed, st->total);
+
+	return fast_tail(pend, st->pending, st->seed ^ st->see1 ^ st->see2,
+			 st->total);
+}
@@ -1,5 +1,6 @@
 /* Licensed under LGPLv2+ - see LICENSE file for details */
 #include <csnippets/htable.h>
+#include <csnippets/math.h>
 
 #include <limits.h>
 #include <assert.h>
@@ -138,6 +139,9 @@ static __cold bool double_table(struct htable *ht)
 		return false;
 	}
 	ht->bits++;
+#ifdef _DEBUG_HTABLE
+	ht->doubles++;
+#endif
 	ht->max = ((size_t)3 << ht->bits) / 4;
 	ht->max_with_deleted = ((size_t)9 << ht->bits) / 10;
 
@@ -169,6 +173,9 @@ static __cold void rehash_table(struct htable *ht)
 	size_t start, i;
 	uintptr_t e;
 
+#ifdef _DEBUG_HTABLE
+	ht->rehashes++;
+#endif
 	/* Beware wrap cases: we need to start from first empty bucket. */
 	for (start = 0; ht->table[start]; start++);
 
@@ -269,3 +276,42 @@ void htable_delval(struct htable *ht, struct htable_iter *i)
 	ht->table[i->off] = HTABLE_DELETED;
 	ht->deleted++;
 }
+
+void htable_stats(const struct htable *ht, struct htable_stats *st)
+{
+	size_t i, n = (size_t)1 << ht->bits, total = 0;
+	uintptr_t mask;
+
+	memset(st, 0, sizeof(*st));
+	st->elems = ht->elems;
+	st->deleted = ht->deleted;
+	st->bits = ht->bits;
+	st->rehashes = ht->rehashes;
+	st->doubles = ht->doubles;
+	st->perfect_bit = ht->perfect_bit != 0;
+	for (mask = ht->common_mask & ~ht->perfect_bit; mask; mask &= mask - 1)
+		st->common_bits++;
+
+	/* An empty table points at perfect_bit, there's nothing to walk.  */
+	if (ht->table == &ht->perfect_bit)
+		return;
+
+	st->load = (double)(ht->elems + ht->deleted) / n;
+	for (i = 0; i < n; i++) {
+		size_t dist;
+		void *p;
+
+		if (!entry_is_valid(ht->table[i]))
+			continue;
+
+		p = get_raw_ptr(ht, ht->table[i]);
+		dist = (i - hash_bucket(ht, ht->rehash(p, ht->priv))) & (n - 1);
+		total += dist;
+		if (dist > st->max_probe)
+			st->max_probe = dist;
+		st->probe_hist[min(dist, (size_t)HTABLE_PROBE_HIST - 1)]++;
+	}
+
+	if (ht->elems)
+		st->avg_probe = (double)total / ht->elems;
+}
@@ -0,0 +1,381 @@
+/*
+ * Copyright (c) 2013 Ahmed Samy  <f.fallen45@gmail.com>
+ * Licensed under MIT, see LICENSE.MIT for details.
+ */
+#include <csnippets/htable_disk.h>
+#include <csnippets/hash.h>
+#include <csnippets/asprintf.h>
+
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#if defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))
+#include <sys/mman.h>
+#define HAVE_MMAP
+#endif
+
+#define HDR_SIZE	64
+#define BUCKET_SIZE	16
+#define REC_HDR_SIZE	8
+#define ALIGN8(x)	(((x) + 7) & ~(size_t)7)
+
+static const char magic[8] = "CSHTABLE";
+
+struct htable_disk {
+	const uint8_t *base;
+	size_t size;
+	bool mapped;	/* munmap() on close, otherwise free() if owned */
+	bool owned;
+
+	size_t mask, elems;
+	uint64_t seed;
+	const uint8_t *buckets;
+	size_t records;
+};
+
+struct bucket_ent {
+	uint64_t hash;
+	size_t off;	/* relative to the first record */
+};
+
+struct htable_disk_builder {
+	uint64_t seed;
+	uint8_t *data;
+	size_t len, cap;
+	struct bucket_ent *ents;
+	size_t nents, maxents;
+};
+
+static inline uint32_t get_le32(const uint8_t *p)
+{
+#ifdef HAVE_LITTLE_ENDIAN
+	uint32_t v;
+	memcpy(&v, p, 4);
+	return v;
+#else
+	return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+#endif
+}
+
+static inline uint64_t get_le64(const uint8_t *p)
+{
+	return get_le32(p) | (uint64_t)get_le32(p + 4) << 32;
+}
+
+static inline void put_le32(uint8_t *p, uint32_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+static inline void put_le64(uint8_t *p, uint64_t v)
+{
+	put_le32(p, v);
+	put_le32(p + 4, v >> 32);
+}
+
+static inline uint64_t key_hash(const void *key, size_t klen, uint64_t seed)
+{
+	return hash64_stable_8(key, klen, seed);
+}
+
+static struct htable_disk *hdisk_setup(const uint8_t *base, size_t size)
+{
+	struct htable_disk *ht;
+	uint64_t bits, elems, boff, roff;
+
+	if (size < HDR_SIZE || memcmp(base, magic, sizeof(magic)) != 0
+	    || get_le32(base + 8) != HTABLE_DISK_VERSION
+	    || get_le64(base + 48) != size)
+		return NULL;
+
+	bits  = get_le32(base + 12);
+	elems = get_le64(base + 16);
+	boff  = get_le64(base + 32);
+	roff  = get_le64(base + 40);
+	/* Compare without adding, a corrupt boff must not wrap around.  */
+	if (bits >= sizeof(size_t) * CHAR_BIT - 5 || elems >= (uint64_t)1 << bits
+	    || roff > size || boff < HDR_SIZE || boff > roff
+	    || ((uint64_t)BUCKET_SIZE << bits) > roff - boff)
+		return NULL;
+
+	xmalloc(ht, sizeof(*ht), return NULL);
+	ht->base = base;
+	ht->size = size;
+	ht->mask = ((size_t)1 << bits) - 1;
+	ht->elems = elems;
+	ht->seed = get_le64(base + 24);
+	ht->buckets = base + boff;
+	ht->records = roff;
+	return ht;
+}
+
+struct htable_disk *htable_disk_from_memory(const void *mem, size_t size)
+{
+	return hdisk_setup(mem, size);
+}
+
+struct htable_disk *htable_disk_open(const char *path)
+{
+	struct htable_disk *ht;
+	struct stat st;
+	void *base;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+	if (fstat(fd, &st) != 0 || st.st_size < HDR_SIZE) {
+		close(fd);
+		return NULL;
+	}
+
+#ifdef HAVE_MMAP
+	base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED)
+		return NULL;
+#else
+	xmalloc(base, st.st_size, close(fd); return NULL);
+	if (read(fd, base, st.st_size) != st.st_size) {
+		free(base);
+		close(fd);
+		return NULL;
+	}
+	close(fd);
+#endif
+
+	ht = hdisk_setup(base, st.st_size);
+	if (!ht) {
+#ifdef HAVE_MMAP
+		munmap(base, st.st_size);
+#else
+		free(base);
+#endif
+		return NULL;
+	}
+
+#ifdef HAVE_MMAP
+	ht->mapped = true;
+#else
+	ht->owned = true;
+#endif
+	return ht;
+}
+
+void htable_disk_close(struct htable_disk *ht)
+{
+	if (!ht)
+		return;
+#ifdef HAVE_MMAP
+	if (ht->mapped)
+		munmap((void *)ht->base, ht->size);
+#endif
+	if (ht->owned)
+		free((void *)ht->base);
+	free(ht);
+}
+
+size_t htable_disk_count(const struct htable_disk *ht)
+{
+	return ht->elems;
+}
+
+/* Returns the record at @off, or NULL if it runs out of the file.  */
+static const uint8_t *get_record(const struct htable_disk *ht, uint64_t off,
+				 size_t *klen, size_t *vlen)
+{
+	const uint8_t *rec;
+
+	if (off < ht->records || off > ht->size - REC_HDR_SIZE)
+		return NULL;
+
+	rec = ht->base + off;
+	*klen = get_le32(rec);
+	*vlen = get_le32(rec + 4);
+	if (*klen + *vlen > ht->size - off - REC_HDR_SIZE)
+		return NULL;
+	return rec + REC_HDR_SIZE;
+}
+
+const void *htable_disk_get(const struct htable_disk *ht,
+			    const void *key, size_t klen, size_t *vlen)
+{
+	uint64_t h = key_hash(key, klen, ht->seed);
+	size_t i, n;
+
+	for (i = h & ht->mask, n = 0; n <= ht->mask; i = (i + 1) & ht->mask, n++) {
+		const uint8_t *b = ht->buckets + i * BUCKET_SIZE;
+		const uint8_t *rec;
+		uint64_t off = get_le64(b + 8);
+		size_t rklen, rvlen;
+
+		if (off == 0)
+			break;
+		if (get_le64(b) != h)
+			continue;
+
+		rec = get_record(ht, off, &rklen, &rvlen);
+		if (rec && rklen == klen && memcmp(rec, key, klen) == 0) {
+			if (vlen)
+				*vlen = rvlen;
+			return rec + rklen;
+		}
+	}
+
+	return NULL;
+}
+
+bool htable_disk_next(const struct htable_disk *ht, size_t *iter,
+		      const void **key, size_t *klen,
+		      const void **val, size_t *vlen)
+{
+	for (; *iter <= ht->mask; ++*iter) {
+		const uint8_t *rec;
+		uint64_t off = get_le64(ht->buckets + *iter * BUCKET_SIZE + 8);
+
+		if (off == 0)
+			continue;
+
+		rec = get_record(ht, off, klen, vlen);
+		if (!rec)
+			continue;
+		*key = rec;
+		*val = rec + *klen;
+		++*iter;
+		return true;
+	}
+
+	return false;
+}
+
+struct htable_disk_builder *htable_disk_builder_new(uint64_t seed)
+{
+	struct htable_disk_builder *b;
+
+	xmalloc(b, sizeof(*b), return NULL);
+	b->seed = seed;
+	return b;
+}
+
+bool htable_disk_builder_add(struct htable_disk_builder *b,
+			     const void *key, size_t klen,
+			     const void *val, size_t vlen)
+{
+	size_t reclen = ALIGN8(REC_HDR_SIZE + klen + vlen);
+	struct bucket_ent *ents;
+	uint8_t *rec, *data;
+
+	if (klen > UINT32_MAX || vlen > UINT32_MAX)
+		return false;
+
+	if (b->len + reclen > b->cap) {
+		size_t ncap = b->cap ? b->cap * 2 : 4096;
+
+		while (ncap < b->len + reclen)
+			ncap *= 2;
+		/* Keep the old block on failure, the builder stays usable.  */
+		xrealloc(data, b->data, ncap, return false);
+		b->data = data;
+		b->cap = ncap;
+	}
+
+	if (b->nents == b->maxents) {
+		size_t nmax = b->maxents ? b->maxents * 2 : 256;
+
+		xrealloc(ents, b->ents, nmax * sizeof(*b->ents), return false);
+		b->ents = ents;
+		b->maxents = nmax;
+	}
+
+	rec = b->data + b->len;
+	put_le32(rec, klen);
+	put_le32(rec + 4, vlen);
+	memcpy(rec + REC_HDR_SIZE, key, klen);
+	memcpy(rec + REC_HDR_SIZE + klen, val, vlen);
+	memset(rec + REC_HDR_SIZE + klen + vlen, 0,
+	       reclen - REC_HDR_SIZE - klen - vlen);
+
+	b->ents[b->nents].hash = key_hash(key, klen, b->seed);
+	b->ents[b->nents].off = b->len;
+	b->nents++;
+	b->len += reclen;
+	return true;
+}
+
+bool htable_disk_builder_write(struct htable_disk_builder *b, const char *path)
+{
+	unsigned int bits = 3;
+	size_t i, nbuckets, roff;
+	uint8_t *head;
+	char *tmp;
+	FILE *fp;
+	bool ok;
+
+	/* Keep the load factor under 3/4.  */
+	while (((size_t)1 << bits) * 3 < b->nents * 4)
+		bits++;
+	nbuckets = (size_t)1 << bits;
+	roff = HDR_SIZE + nbuckets * BUCKET_SIZE;
+
+	xcalloc(head, 1, roff, return false);
+	memcpy(head, magic, sizeof(magic));
+	put_le32(head + 8, HTABLE_DISK_VERSION);
+	put_le32(head + 12, bits);
+	put_le64(head + 16, b->nents);
+	put_le64(head + 24, b->seed);
+	put_le64(head + 32, HDR_SIZE);
+	put_le64(head + 40, roff);
+	put_le64(head + 48, roff + b->len);
+
+	for (i = 0; i < b->nents; i++) {
+		size_t j = b->ents[i].hash & (nbuckets - 1);
+		uint8_t *bucket;
+
+		while (get_le64(head + HDR_SIZE + j * BUCKET_SIZE + 8) != 0)
+			j = (j + 1) & (nbuckets - 1);
+
+		bucket = head + HDR_SIZE + j * BUCKET_SIZE;
+		put_le64(bucket, b->ents[i].hash);
+		put_le64(bucket + 8, roff + b->ents[i].off);
+	}
+
+	if (asprintf(&tmp, "%s.tmp", path) < 0) {
+		free(head);
+		return false;
+	}
+
+	fp = fopen(tmp, "wb");
+	if (!fp) {
+		free(tmp);
+		free(head);
+		return false;
+	}
+
+	ok = fwrite(head, 1, roff, fp) == roff
+		&& fwrite(b->data, 1, b->len, fp) == b->len;
+	ok = fclose(fp) == 0 && ok;
+	if (ok)
+		ok = rename(tmp, path) == 0;
+	if (!ok) {
+		int saved = errno;
+		unlink(tmp);
+		errno = saved;
+	}
+
+	free(tmp);
+	free(head);
+	return ok;
+}
+
+void htable_disk_builder_free(struct htable_disk_builder *b)
+{
+	if (!b)
+		return;
+	free(b->data);
+	free(b->ents);
+	free(b);
+}
@@ -0,0 +1,298 @@
+/*
+ * Copyright (c) 2013 Ahmed Samy  <f.fallen45@gmail.com>
+ * Licensed under MIT, see LICENSE.MIT for details.
+ *
+ * Rebalancing for intrusive red-black trees, the algorithms are the
+ * classic ones (see Cormen et al.), without sentinel nodes.
+ */
+#include <csnippets/irbtree.h>
+
+static inline bool irb_is_red(const struct irb_node *n)
+{
+	return n && !(n->parent_color & IRB_BLACK);
+}
+
+static inline bool irb_is_black(const struct irb_node *n)
+{
+	return !irb_is_red(n);
+}
+
+static inline void irb_set_red(struct irb_node *n)
+{
+	n->parent_color &= ~(uintptr_t)IRB_BLACK;
+}
+
+static inline void irb_set_black(struct irb_node *n)
+{
+	n->parent_color |= IRB_BLACK;
+}
+
+static inline void irb_set_parent(struct irb_node *n, struct irb_node *parent)
+{
+	n->parent_color = (uintptr_t)parent | (n->parent_color & 3);
+}
+
+static inline void irb_set_color(struct irb_node *n, uintptr_t color)
+{
+	n->parent_color = (n->parent_color & ~(uintptr_t)1) | color;
+}
+
+/* Make @parent (or the root) point to @new instead of @old.  */
+static inline void irb_change_child(struct irb_node *old, struct irb_node *new,
+				    struct irb_node *parent, struct irb_root *root)
+{
+	if (!parent)
+		root->node = new;
+	else if (parent->left == old)
+		parent->left = new;
+	else
+		parent->right = new;
+}
+
+static void irb_rotate_left(struct irb_node *a, struct irb_root *root)
+{
+	struct irb_node *b = a->right, *parent = irb_parent(a);
+
+	a->right = b->left;
+	if (b->left)
+		irb_set_parent(b->left, a);
+	b->left = a;
+	irb_set_parent(b, parent);
+	irb_change_child(a, b, parent, root);
+	irb_set_parent(a, b);
+}
+
+static void irb_rotate_right(struct irb_node *b, struct irb_root *root)
+{
+	struct irb_node *a = b->left, *parent = irb_parent(b);
+
+	b->left = a->right;
+	if (a->right)
+		irb_set_parent(a->right, b);
+	a->right = b;
+	irb_set_parent(a, parent);
+	irb_change_child(b, a, parent, root);
+	irb_set_parent(b, a);
+}
+
+void irb_insert_color(struct irb_node *n, struct irb_root *root)
+{
+	struct irb_node *parent, *gparent, *uncle, *tmp;
+
+	while ((parent = irb_parent(n)) && irb_is_red(parent)) {
+		/* A red node is never the root, so this exists.  */
+		gparent = irb_parent(parent);
+
+		if (parent == gparent->left) {
+			uncle = gparent->right;
+			if (irb_is_red(uncle)) {
+				irb_set_black(uncle);
+				irb_set_black(parent);
+				irb_set_red(gparent);
+				n = gparent;
+				continue;
+			}
+
+			if (n == parent->right) {
+				irb_rotate_left(parent, root);
+				tmp = parent;
+				parent = n;
+				n = tmp;
+			}
+
+			irb_set_black(parent);
+			irb_set_red(gparent);
+			irb_rotate_right(gparent, root);
+		} else {
+			uncle = gparent->left;
+			if (irb_is_red(uncle)) {
+				irb_set_black(uncle);
+				irb_set_black(parent);
+				irb_set_red(gparent);
+				n = gparent;
+				continue;
+			}
+
+			if (n == parent->left) {
+				irb_rotate_right(parent, root);
+				tmp = parent;
+				parent = n;
+				n = tmp;
+			}
+
+			irb_set_black(parent);
+			irb_set_red(gparent);
+			irb_rotate_left(gparent, root);
+		}
+	}
+
+	irb_set_black(root->node);
+}
+
+/* @n (possibly NULL) is short of one black node, @parent is its parent.  */
+static void irb_erase_color(struct irb_node *n, struct irb_node *parent,
+			    struct irb_root *root)
+{
+	struct irb_node *sib;
+
+	while (irb_is_black(n) && n != root->node) {
+		if (parent->left == n) {
+			sib = parent->right;
+			if (irb_is_red(sib)) {
+				irb_set_black(sib);
+				irb_set_red(parent);
+				irb_rotate_left(parent, root);
+				sib = parent->right;
+			}
+
+			if (irb_is_black(sib->left) && irb_is_black(sib->right)) {
+				irb_set_red(sib);
+				n = parent;
+				parent = irb_parent(n);
+				continue;
+			}
+
+			if (irb_is_black(sib->right)) {
+				irb_set_black(sib->left);
+				irb_set_red(sib);
+				irb_rotate_right(sib, root);
+				sib = parent->right;
+			}
+
+			irb_set_color(sib, parent->parent_color & 1);
+			irb_set_black(parent);
+			irb_set_black(sib->right);
+			irb_rotate_left(parent, root);
+		} else {
+			sib = parent->left;
+			if (irb_is_red(sib)) {
+				irb_set_black(sib);
+				irb_set_red(parent);
+				irb_rotate_right(parent, root);
+				sib = parent->left;
+			}
+
+			if (irb_is_black(sib->left) && irb_is_black(sib->right)) {
+				irb_set_red(sib);
+				n = parent;
+				parent = irb_parent(n);
+				continue;
+			}
+
+			if (irb_is_black(sib->left)) {
+				irb_set_black(sib->right);
+				irb_set_red(sib);
+				irb_rotate_left(sib, root);
+				sib = parent->left;
+			}
+
+			irb_set_color(sib, parent->parent_color & 1);
+			irb_set_black(parent);
+			irb_set_black(sib->left);
+			irb_rotate_right(parent, root);
+		}
+
+		n = root->node;
+		break;
+	}
+
+	if (n)
+		irb_set_black(n);
+}
+
+void irb_erase(struct irb_node *n, struct irb_root *root)
+{
+	struct irb_node *child, *parent;
+	uintptr_t color;
+
+	if (n->left && n->right) {
+		/* Put the successor in n's place, the successor has no
+		 * left child so it's easy to unlink.  */
+		struct irb_node *next = n->right;
+
+		while (next->left)
+			next = next->left;
+		irb_change_child(n, next, irb_parent(n), root);
+
+		child = next->right;
+		parent = irb_parent(next);
+		color = next->parent_color & 1;
+		if (parent == n)
+			parent = next;
+		else {
+			if (child)
+				irb_set_parent(child, parent);
+			parent->left = child;
+			next->right = n->right;
+			irb_set_parent(n->right, next);
+		}
+
+		next->parent_color = n->parent_color;
+		next->left = n->left;
+		irb_set_parent(n->left, next);
+	} else {
+		child = n->left ? n->left : n->right;
+		parent = irb_parent(n);
+		color = n->parent_color & 1;
+		if (child)
+			irb_set_parent(child, parent);
+		irb_change_child(n, child, parent, root);
+	}
+
+	if (color == IRB_BLACK)
+		irb_erase_color(child, parent, root);
+}
+
+struct irb_node *irb_first(const struct irb_root *root)
+{
+	struct irb_node *n = root->node;
+
+	if (!n)
+		return NULL;
+	while (n->left)
+		n = n->left;
+	return n;
+}
+
+struct irb_node *irb_last(const struct irb_root *root)
+{
+	struct irb_node *n = root->node;
+
+	if (!n)
+		return NULL;
+	while (n->right)
+		n = n->right;
+	return n;
+}
+
+struct irb_node *irb_next(const struct irb_node *n)
+{
+	struct irb_node *parent;
+
+	if (n->right) {
+		n = n->right;
+		while (n->left)
+			n = n->left;
+		return (struct irb_node *)n;
+	}
+
+	while ((parent = irb_parent(n)) && n == parent->right)
+		n = parent;
+	return parent;
+}
+
+struct irb_node *irb_prev(const struct irb_node *n)
+{
+	struct irb_node *parent;
+
+	if (n->left) {
+		n = n->left;
+		while (n->right)
+			n = n->right;
+		return (struct irb_node *)n;
+	}
+
+	while ((parent = irb_parent(n)) && n == parent->left)
+		n = parent;
+	return parent;
+}
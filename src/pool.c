@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2013 Ahmed Samy  <f.fallen45@gmail.com>
+ * Licensed under MIT, see LICENSE.MIT for details.
+ */
+#include <csnippets/pool.h>
+
+/* Carve a new batch of objects and put them on @list, called with the
+ * pool locked.  */
+static __cold bool pool_grow(struct pool *p, struct pool_free **list)
+{
+	char *mem;
+	size_t i;
+
+	mem = malloc(p->size * POOL_BATCH);
+	if (!mem)
+		return false;
+
+	for (i = 0; i < POOL_BATCH; i++) {
+		struct pool_free *obj = (struct pool_free *)(mem + i * p->size);
+
+		obj->next = *list;
+		*list = obj;
+	}
+	return true;
+}
+
+void *pool_get(struct pool *p)
+{
+	struct pool_free *obj = NULL;
+
+	pthread_mutex_lock(&p->lock);
+	if (p->free || pool_grow(p, &p->free)) {
+		obj = p->free;
+		p->free = obj->next;
+	}
+	pthread_mutex_unlock(&p->lock);
+	return obj;
+}
+
+void pool_put(struct pool *p, void *ptr)
+{
+	struct pool_free *obj = ptr;
+
+	if (!obj)
+		return;
+
+	pthread_mutex_lock(&p->lock);
+	obj->next = p->free;
+	p->free = obj;
+	pthread_mutex_unlock(&p->lock);
+}
+
+static pthread_key_t cache_key;
+static pthread_once_t cache_once = PTHREAD_ONCE_INIT;
+
+/* Give the caches of an exiting thread back to their pools.  */
+static void pool_thread_exit(void *arg)
+{
+	struct pool_cache *c, *next;
+
+	for (c = arg; c; c = next) {
+		next = c->next;
+		pool_release(c->pool, c, c->count);
+	}
+}
+
+static void pool_key_create(void)
+{
+	pthread_key_create(&cache_key, pool_thread_exit);
+}
+
+void pool_cache_register(struct pool *p, struct pool_cache *c)
+{
+	pthread_once(&cache_once, pool_key_create);
+	c->pool = p;
+	c->next = pthread_getspecific(cache_key);
+	pthread_setspecific(cache_key, c);
+}
+
+bool pool_refill(struct pool *p, struct pool_cache *c)
+{
+	struct pool_free *obj;
+	size_t n = 0;
+
+	if (unlikely(!c->pool))
+		pool_cache_register(p, c);
+
+	pthread_mutex_lock(&p->lock);
+	if (!p->free) {
+		if (pool_grow(p, &c->head))
+			n = POOL_BATCH;
+	} else {
+		while (p->free && n < POOL_BATCH) {
+			obj = p->free;
+			p->free = obj->next;
+			obj->next = c->head;
+			c->head = obj;
+			n++;
+		}
+	}
+	pthread_mutex_unlock(&p->lock);
+
+	c->count += n;
+	return n != 0;
+}
+
+void pool_release(struct pool *p, struct pool_cache *c, size_t n)
+{
+	struct pool_free *first = c->head, *last;
+	size_t i;
+
+	if (!n)
+		return;
+
+	/* Cut the first @n objects off the cache, then splice them in with
+	 * a single lock.  */
+	for (last = first, i = 1; i < n; i++)
+		last = last->next;
+	c->head = last->next;
+	c->count -= n;
+
+	pthread_mutex_lock(&p->lock);
+	last->next = p->free;
+	p->free = first;
+	pthread_mutex_unlock(&p->lock);
+}
@@ -26,10 +26,13 @@
  */
 
 #include <csnippets/rbtree.h>
+#include <csnippets/pool.h>
 
 #include <stdlib.h>
 #include <stdio.h>
 
+POOL_DEFINE_CACHED_TYPE(rb_node, node);
+
 static void rotate_left(rb_tree *tree, rb_node *a)
 {
 	rb_node *b;
@@ -48,6 +51,11 @@ static void rotate_left(rb_tree *tree, rb_node *a)
 
 	b->left = a;
 	a->parent = b;
+
+	if (tree->augmented) {
+		b->size = a->size;
+		a->size = a->left->size + a->right->size + 1;
+	}
 }
 
 static void rotate_right(rb_tree *tree, rb_node *b)
@@ -68,6 +76,11 @@ static void rotate_right(rb_tree *tree, rb_node *b)
 
 	a->right = b;
 	b->parent = a;
+
+	if (tree->augmented) {
+		a->size = b->size;
+		b->size = b->left->size + b->right->size + 1;
+	}
 }
 
 static void insert_auxiliar(rb_tree *tree, rb_node *c)
@@ -79,16 +92,20 @@ static void insert_auxiliar(rb_tree *tree, rb_node *c)
 	b = tree->root;
 	a = tree->root->left;
 
+	c->size = 1;
 	while (a != null) {
 		b = a;
-		if (tree->compare(a->key, c->key) == 1)
+		if (tree->augmented)
+			a->size++;
+		if (tree->compare(a->key, c->key) > 0)
 			a = a->left;
 		else
 			a = a->right;
 	}
 
 	c->parent = b;
-	if (b == tree->root || tree->compare(b->key, c->key))
+	/* Equal keys go right, after the ones already there.  */
+	if (b == tree->root || tree->compare(b->key, c->key) > 0)
 		b->left = c;
 	else
 		b->right = c;
@@ -96,7 +113,7 @@ static void insert_auxiliar(rb_tree *tree, rb_node *c)
 
 static void rbtree_fixup(rb_tree *tree, rb_node *a)
 {
-	rb_node *root = tree->root;
+	rb_node *root = tree->root->left;
 	rb_node *w;
 
 	while (!a->red && a != root) {
@@ -132,6 +149,7 @@ static void rbtree_fixup(rb_tree *tree, rb_node *a)
 				w->red = false;
 				a->parent->red = true;
 				rotate_right(tree, a->parent);
+				w = a->parent->left;
 			}
 
 			if (!w->right->red && !w->left->red) {
@@ -157,15 +175,44 @@ static void rbtree_fixup(rb_tree *tree, rb_node *a)
 	a->red = false;
 }
 
-static void destroy_auxiliar(rb_tree *tree, rb_node *n)
+static void destroy_node(rb_tree *tree, rb_node *n)
 {
-	rb_node *null = tree->null;
-	if (n != null) {
-		destroy_auxiliar(tree, n->left);
-		destroy_auxiliar(tree, n->right);
+	if (tree->destroy_key)
 		tree->destroy_key(n->key);
+	if (tree->destroy_info)
 		tree->destroy_info(n->info);
-		free(n);
+	/* Slab nodes are freed all at once by rbtree_destroy().  */
+	if (!n->slab) {
+		tree->heap_nodes--;
+		node_free(n);
+	}
+}
+
+/* Postorder walk using the parent links instead of recursion: go down
+ * to a leaf, cut it off and go back to its parent.  */
+static void destroy_auxiliar(rb_tree *tree, rb_node *n)
+{
+	rb_node *null = tree->null;
+	rb_node *root = tree->root;
+	rb_node *parent;
+
+	while (n != null) {
+		if (n->left != null) {
+			n = n->left;
+			continue;
+		}
+		if (n->right != null) {
+			n = n->right;
+			continue;
+		}
+
+		parent = n->parent;
+		if (parent->left == n)
+			parent->left = null;
+		else
+			parent->right = null;
+		destroy_node(tree, n);
+		n = parent == root ? null : parent;
 	}
 }
 
@@ -222,6 +269,9 @@ rb_tree *rbtree_create(int (*compare) (const void *, const void *),
 	if (!ret)
 		return NULL;
 
+	ret->augmented	  = false;
+	ret->slabs	  = NULL;
+	ret->heap_nodes	  = 0;
 	ret->compare	  = compare;
 	ret->destroy_key  = destroy_key;
 	ret->destroy_info = destroy_info;
@@ -234,7 +284,8 @@ rb_tree *rbtree_create(int (*compare) (const void *, const void *),
 		return NULL;
 	}
 
-	tmp->parent = tmp->left = tmp->right;
+	tmp->parent = tmp->left = tmp->right = tmp;
+	tmp->size = 0;
 	tmp->red = false;
 	tmp->key = NULL;
 	ret->null = tmp;
@@ -247,6 +298,7 @@ rb_tree *rbtree_create(int (*compare) (const void *, const void *),
 	}
 
 	tmp->parent = tmp->left = tmp->right = ret->null;
+	tmp->size = 0;
 	tmp->red = false;
 	tmp->key = NULL;
 	ret->root = tmp;
@@ -256,7 +308,15 @@ rb_tree *rbtree_create(int (*compare) (const void *, const void *),
 
 void rbtree_destroy(rb_tree *tree)
 {
-	destroy_auxiliar(tree, tree->root->left);
+	struct rb_slab *slab, *next;
+
+	/* Nothing to call and nothing to free one by one: skip the walk.  */
+	if (tree->destroy_key || tree->destroy_info || tree->heap_nodes)
+		destroy_auxiliar(tree, tree->root->left);
+	for (slab = tree->slabs; slab; slab = next) {
+		next = slab->next;
+		free(slab);
+	}
 	free(tree->root);
 	free(tree->null);
 	free(tree);
@@ -267,9 +327,11 @@ rb_node *rbtree_insert(rb_tree *tree, void *key, void *info)
 	rb_node *a, *b;
 	rb_node *node;
 
-	a = malloc(sizeof(*a));
+	a = node_alloc();
 	if (!a)
 		return NULL;
+	a->slab = false;
+	tree->heap_nodes++;
 	a->key = key;
 	a->info = info;
 
@@ -284,6 +346,7 @@ rb_node *rbtree_insert(rb_tree *tree, void *key, void *info)
 				a->parent->red = false;
 				b->red = false;
 				a->parent->parent->red = true;
+				a = a->parent->parent;
 			} else {
 				if (a == a->parent->right) { 
 					a = a->parent;
@@ -336,28 +399,33 @@ void rbtree_remove(rb_tree *tree, rb_node *c)
 			b->parent->right = a;
 	}
 
+	/* b is gone, everything above it lost one node.  */
+	if (tree->augmented) {
+		rb_node *x;
+
+		for (x = a->parent; x != root; x = x->parent)
+			x->size--;
+	}
+
 	if (b != c) {
 		if (!b->red)
 			rbtree_fixup(tree, a);
 
-		tree->destroy_key(c->key);
-		tree->destroy_info(c->info);
 		b->left = c->left;
 		b->right = c->right;
 		b->parent = c->parent;
 		b->red = c->red;
+		b->size = c->size;
 		c->left->parent = c->right->parent = b;
 		if (c == c->parent->left)
 			c->parent->left = b;
 		else
 			c->parent->right = b;
-		free(c);
+		destroy_node(tree, c);
 	} else {
-		tree->destroy_key(b->key);
-		tree->destroy_info(b->info);
 		if (!b->red)
 			rbtree_fixup(tree, a);
-		free(b);
+		destroy_node(tree, b);
 	}
 }
 
@@ -418,7 +486,7 @@ rb_node *rbtree_query(rb_tree *tree, void *query)
 
 	comp_val = tree->compare(a->key, query);
 	while (comp_val != 0) {
-		if (comp_val == 1) /* a->key > query */
+		if (comp_val > 0) /* a->key > query */
 			a = a->left;
 		else
 			a = a->right;
@@ -435,3 +503,185 @@ void rbtree_print(rb_tree *tree)
 	_rbtree_print(tree, tree->root->left);
 }
 
+rb_node *rbtree_first(rb_tree *tree)
+{
+	rb_node *a = tree->root->left;
+	rb_node *null = tree->null;
+
+	if (a == null)
+		return NULL;
+	while (a->left != null)
+		a = a->left;
+	return a;
+}
+
+rb_node *rbtree_last(rb_tree *tree)
+{
+	rb_node *a = tree->root->left;
+	rb_node *null = tree->null;
+
+	if (a == null)
+		return NULL;
+	while (a->right != null)
+		a = a->right;
+	return a;
+}
+
+/* The leftmost node whose key is >= @key (> @key if @upper).  */
+static rb_node *bound(rb_tree *tree, const void *key, bool upper)
+{
+	rb_node *a = tree->root->left;
+	rb_node *null = tree->null;
+	rb_node *best = NULL;
+
+	while (a != null) {
+		int comp_val = tree->compare(a->key, key);
+
+		if (comp_val > 0 || (comp_val == 0 && !upper)) {
+			best = a;
+			a = a->left;
+		} else
+			a = a->right;
+	}
+
+	return best;
+}
+
+rb_node *rbtree_lower_bound(rb_tree *tree, const void *key)
+{
+	return bound(tree, key, false);
+}
+
+rb_node *rbtree_upper_bound(rb_tree *tree, const void *key)
+{
+	return bound(tree, key, true);
+}
+
+rb_node *rbtree_range_first(rb_tree *tree, rb_iter *it,
+			    const void *lo, const void *hi)
+{
+	it->tree = tree;
+	it->hi = hi;
+	it->node = rbtree_lower_bound(tree, lo);
+	if (it->node && tree->compare(it->node->key, hi) >= 0)
+		it->node = NULL;
+	return it->node;
+}
+
+rb_node *rbtree_range_next(rb_iter *it)
+{
+	rb_tree *tree = it->tree;
+	rb_node *a = rbtree_successor(tree, it->node);
+
+	if (a == tree->null || tree->compare(a->key, it->hi) >= 0)
+		a = NULL;
+	it->node = a;
+	return a;
+}
+
+static size_t augment_auxiliar(rb_tree *tree, rb_node *n)
+{
+	if (n == tree->null)
+		return 0;
+
+	n->size = augment_auxiliar(tree, n->left)
+		+ augment_auxiliar(tree, n->right) + 1;
+	return n->size;
+}
+
+void rbtree_augment(rb_tree *tree)
+{
+	if (tree->augmented)
+		return;
+
+	augment_auxiliar(tree, tree->root->left);
+	tree->augmented = true;
+}
+
+size_t rbtree_rank(rb_tree *tree, rb_node *a)
+{
+	rb_node *root = tree->root;
+	size_t rank;
+
+	assert(tree->augmented);
+	rank = a->left->size;
+	for (; a->parent != root; a = a->parent)
+		if (a == a->parent->right)
+			rank += a->parent->left->size + 1;
+
+	return rank;
+}
+
+rb_node *rbtree_select(rb_tree *tree, size_t k)
+{
+	rb_node *a = tree->root->left;
+	rb_node *null = tree->null;
+
+	assert(tree->augmented);
+	while (a != null) {
+		size_t left = a->left->size;
+
+		if (k == left)
+			return a;
+		if (k < left)
+			a = a->left;
+		else {
+			k -= left + 1;
+			a = a->right;
+		}
+	}
+
+	return NULL;
+}
+
+static rb_node *build_auxiliar(rb_tree *tree, rb_node *nodes, void **keys,
+			       void **infos, size_t lo, size_t hi,
+			       rb_node *parent, int depth, int red_depth)
+{
+	size_t mid;
+	rb_node *a;
+
+	if (lo >= hi)
+		return tree->null;
+
+	mid = lo + (hi - lo) / 2;
+	a = &nodes[mid];
+	a->key = keys[mid];
+	a->info = infos ? infos[mid] : NULL;
+	a->red = depth == red_depth;
+	a->slab = true;
+	a->size = hi - lo;
+	a->parent = parent;
+	a->left = build_auxiliar(tree, nodes, keys, infos, lo, mid,
+				 a, depth + 1, red_depth);
+	a->right = build_auxiliar(tree, nodes, keys, infos, mid + 1, hi,
+				  a, depth + 1, red_depth);
+	return a;
+}
+
+bool rbtree_build_sorted(rb_tree *tree, void **keys, void **infos, size_t n)
+{
+	struct rb_slab *slab;
+	int red_depth = 0;
+
+	if (tree->root->left != tree->null)
+		return false;
+	if (n == 0)
+		return true;
+
+	slab = malloc(sizeof(*slab) + n * sizeof(rb_node));
+	if (!slab)
+		return false;
+	slab->next = tree->slabs;
+	tree->slabs = slab;
+
+	/* Splitting at the middle gives a tree whose levels are all full
+	 * but the last one.  With every full level black and the partial
+	 * one red, all paths have the same number of black nodes.  */
+	while (((size_t)2 << red_depth) - 1 <= n)
+		red_depth++;
+
+	tree->root->left = build_auxiliar(tree, slab->nodes, keys, infos, 0, n,
+					  tree->root, 0, red_depth);
+	return true;
+}
@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2013 Ahmed Samy  <f.fallen45@gmail.com>
+ * Licensed under MIT, see LICENSE.MIT for details.
+ */
+#include <csnippets/rope.h>
+
+static inline size_t min_size(size_t a, size_t b)
+{
+	return a < b ? a : b;
+}
+
+static struct rope_chunk *rope_next(const rope_t *r, struct rope_chunk *c)
+{
+	if (c->node.next == &r->chunks.n)
+		return NULL;
+	return list_entry(c->node.next, struct rope_chunk, node);
+}
+
+/* Allocate @n empty chunks on @list, all or nothing.  */
+static bool rope_alloc_chunks(struct list_head *list, size_t n)
+{
+	struct rope_chunk *c, *next;
+
+	while (n--) {
+		c = malloc(sizeof(*c));
+		if (!c) {
+			list_for_each_safe(list, c, next, node)
+				free(c);
+			return false;
+		}
+		list_add_tail(list, &c->node);
+	}
+	return true;
+}
+
+rope_t *rope_new(void)
+{
+	rope_t *r;
+
+	xmalloc(r, sizeof(*r), return NULL);
+	list_head_init(&r->chunks);
+	r->len = 0;
+	return r;
+}
+
+void rope_free(rope_t *r)
+{
+	struct rope_chunk *c, *next;
+
+	if (!r)
+		return;
+
+	list_for_each_safe(&r->chunks, c, next, node)
+		free(c);
+	free(r);
+}
+
+bool rope_append(rope_t *r, const void *data, size_t len)
+{
+	struct rope_chunk *c = list_tail(&r->chunks, struct rope_chunk, node);
+	const uint8_t *p = data;
+	size_t room = c ? ROPE_CHUNK_SIZE - c->end : 0, n;
+	LIST_HEAD(fresh);
+
+	if (len > room
+	    && !rope_alloc_chunks(&fresh, (len - room + ROPE_CHUNK_SIZE - 1) / ROPE_CHUNK_SIZE))
+		return false;
+
+	r->len += len;
+	if (room) {
+		n = min_size(room, len);
+		memcpy(&c->data[c->end], p, n);
+		c->end += n;
+		p += n;
+		len -= n;
+	}
+
+	while ((c = list_top(&fresh, struct rope_chunk, node))) {
+		n = min_size(ROPE_CHUNK_SIZE, len);
+		memcpy(c->data, p, n);
+		c->start = 0;
+		c->end = n;
+		p += n;
+		len -= n;
+
+		list_del_from(&fresh, &c->node);
+		list_add_tail(&r->chunks, &c->node);
+	}
+
+	return true;
+}
+
+bool rope_prepend(rope_t *r, const void *data, size_t len)
+{
+	struct rope_chunk *c = list_top(&r->chunks, struct rope_chunk, node);
+	const uint8_t *p = (const uint8_t *)data + len;
+	size_t room = c ? c->start : 0, n;
+	LIST_HEAD(fresh);
+
+	if (len > room
+	    && !rope_alloc_chunks(&fresh, (len - room + ROPE_CHUNK_SIZE - 1) / ROPE_CHUNK_SIZE))
+		return false;
+
+	/* Go backwards from the end of @data, filling chunks from their end
+	 * so that the next prepend has room in front.  */
+	r->len += len;
+	if (room) {
+		n = min_size(room, len);
+		p -= n;
+		c->start -= n;
+		memcpy(&c->data[c->start], p, n);
+		len -= n;
+	}
+
+	while ((c = list_top(&fresh, struct rope_chunk, node))) {
+		n = min_size(ROPE_CHUNK_SIZE, len);
+		p -= n;
+		c->start = ROPE_CHUNK_SIZE - n;
+		c->end = ROPE_CHUNK_SIZE;
+		memcpy(&c->data[c->start], p, n);
+		len -= n;
+
+		list_del_from(&fresh, &c->node);
+		list_add(&r->chunks, &c->node);
+	}
+
+	return true;
+}
+
+void rope_consume(rope_t *r, size_t len)
+{
+	struct rope_chunk *c;
+	size_t n;
+
+	while (len && (c = list_top(&r->chunks, struct rope_chunk, node))) {
+		n = min_size(len, c->end - c->start);
+		c->start += n;
+		r->len -= n;
+		len -= n;
+
+		if (c->start == c->end) {
+			list_del_from(&r->chunks, &c->node);
+			free(c);
+		}
+	}
+}
+
+int rope_iovec(const rope_t *r, struct iovec *iov, int max)
+{
+	struct rope_chunk *c;
+	int i = 0;
+
+	list_for_each(&r->chunks, c, node) {
+		if (i == max)
+			break;
+		iov[i].iov_base = &c->data[c->start];
+		iov[i].iov_len = c->end - c->start;
+		i++;
+	}
+
+	return i;
+}
+
+void rope_cursor_init(rope_cursor_t *c, const rope_t *r)
+{
+	c->rope = r;
+	c->chunk = list_top(&r->chunks, struct rope_chunk, node);
+	c->pos = c->chunk ? c->chunk->start : 0;
+}
+
+static size_t rope_advance(rope_cursor_t *c, void *out, size_t len)
+{
+	uint8_t *p = out;
+	size_t done = 0, n;
+
+	while (done < len && c->chunk) {
+		n = min_size(len - done, c->chunk->end - c->pos);
+		if (p) {
+			memcpy(p, &c->chunk->data[c->pos], n);
+			p += n;
+		}
+		c->pos += n;
+		done += n;
+
+		if (c->pos == c->chunk->end) {
+			c->chunk = rope_next(c->rope, c->chunk);
+			c->pos = c->chunk ? c->chunk->start : 0;
+		}
+	}
+
+	return done;
+}
+
+size_t rope_read(rope_cursor_t *c, void *out, size_t len)
+{
+	return rope_advance(c, out, len);
+}
+
+size_t rope_skip(rope_cursor_t *c, size_t len)
+{
+	return rope_advance(c, NULL, len);
+}
@@ -7,14 +7,21 @@
 #include <csnippets/asprintf.h>  /* Needed in conn_writestr  */
 #include <csnippets/poll.h>      /* Fake poll(2) enviroment that is cross-platform.  (Part of gnulib) */
 #include <csnippets/list.h>
-#include <csnippets/htable.h>
+#include <csnippets/htable_flat.h>
 #include <csnippets/hash.h>
+#include <csnippets/pool.h>
+#include <csnippets/rope.h>
 
 #include <internal/socket_compat.h>
 
-struct sk_buff {
-	char *data;
-	size_t size;
+#define ROPE_IOV_MAX	64
+
+/* Data waiting to be sent, either a buffer (data[rpos, wpos) is what's
+ * left) or a rope.  */
+struct wq_entry {
+	buffer_t *buf;
+	rope_t *rope;
+	struct wq_entry *next;
 };
 
 typedef struct listener {
@@ -37,52 +44,46 @@ typedef struct conn {
 	bool in_progress;
 
 	struct sockaddr sa;
-	struct sk_buff wb;
+	struct wq_entry *wq_head, **wq_tail;
 } conn_t;
 
+POOL_DEFINE_TYPE(listener_t, listener);
+POOL_DEFINE_CACHED_TYPE(conn_t, conn);
+POOL_DEFINE_CACHED_TYPE(struct wq_entry, wq_entry);
+
 static pollev_t *io_events;
 static LIST_HEAD(listeners);
 
-static size_t chash(int fd)
+static inline size_t chash(int fd)
 {
 	return hash_u32((uint32_t *)&fd, 1, 0);
 }
 
-static size_t rehash(const void *e, void *__unused unused)
+static inline bool fdeq(int a, int b)
 {
-	return chash(((conn_t *)e)->fd);
+	return a == b;
 }
-static struct htable conns = HTABLE_INITIALIZER(conns, rehash, NULL);
+
+/* fd -> conn_t map, the fd is kept inline so lookups don't have to
+ * dereference each candidate connection.  */
+HTABLE_DEFINE_FLAT_TYPE(int, conn_t *, chash, fdeq, conn_map);
+static struct conn_map conns = HTABLE_FLAT_INITIALIZER;
 
 static inline conn_t *find_conn(int fd)
 {
-	int fdhash = chash(fd);
-	conn_t *c;
-	struct htable_iter i;
-
-	for (c = htable_firstval(&conns, &i, fdhash); c; c = htable_nextval(&conns, &i, fdhash))
-		if (c->fd == fd)
-			return c;
-	return NULL;
+	conn_t **c = conn_map_get(&conns, fd);
+	return c ? *c : NULL;
 }
 
 static inline void add_conn(conn_t *c)
 {
-	if (!htable_add(&conns, chash(c->fd), c))
+	if (!conn_map_add(&conns, c->fd, c))
 		__builtin_unreachable ();
 }
 
 static inline void rm_conn(const conn_t *c)
 {
-	int fdhash = chash(c->fd);
-	conn_t *tmp;
-	struct htable_iter i;
-
-	for (tmp = htable_firstval(&conns, &i, fdhash); tmp; tmp = htable_nextval(&conns, &i, fdhash))
-		if (tmp->fd == c->fd) {
-			htable_delval(&conns, &i);
-			break;
-		}
+	conn_map_del(&conns, c->fd);
 }
 
 static listener_t *find_listener(int fd)
@@ -95,75 +96,140 @@ static listener_t *find_listener(int fd)
 	return NULL;
 }
 
-static bool do_write(conn_t *conn, const void *data, size_t len)
+/* Send as much of @data as the socket takes, returns the number of
+ * bytes sent, or -1 if the connection is broken.  */
+static ssize_t send_some(int fd, const char *data, size_t len)
 {
-	int t_bytes = 0, r_bytes = len, n = -1;
-	struct sk_buff *skb = &conn->wb;
+	size_t sent = 0;
+	ssize_t n;
 
 	might_bug();
-	while (t_bytes < len) {
-		if (!skb->data)
-			do
-				n = send(conn->fd, data + t_bytes, r_bytes, 0);
-			while (n == -1 && S_error == S_EINTR);
+	while (sent < len) {
+		do
+			n = send(fd, data + sent, len - sent, 0);
+		while (n == -1 && S_error == S_EINTR);
+		if (n == -1)
+			return IsBlocking() ? (ssize_t)sent : -1;
+		sent += n;
+	}
 
-		if (n < 0) {
-			if ((IsBlocking() && r_bytes > 0) || skb->data) {
-				if (!skb->data) {
-					skb->size = r_bytes + 128;
-					xmalloc(skb->data, sizeof(char) * skb->size,
-					        return -1);
-				} else {
-					skb->size += r_bytes;
-					alloc_grow(skb->data, sizeof(char) * skb->size,
-					           return -1);
-				}
+	return sent;
+}
 
-				memcpy(skb->data + (skb->size - r_bytes), data + t_bytes, r_bytes);
-				return false;
-			}
+/* Send as much of @r as the socket takes and drop it from @r, returns
+ * the number of bytes sent, or -1 if the connection is broken.  */
+static ssize_t send_rope(int fd, rope_t *r)
+{
+	struct iovec iov[ROPE_IOV_MAX];
+	size_t sent = 0;
+	ssize_t n;
+	int cnt;
 
+	while (rope_len(r)) {
+		cnt = rope_iovec(r, iov, ROPE_IOV_MAX);
+#ifdef _WIN32
+		/* One segment at a time.  */
+		n = send_some(fd, iov[0].iov_base, iov[0].iov_len);
+		if (n < 0)
+			return -1;
+		(void)cnt;
+#else
+		do
+			n = writev(fd, iov, cnt);
+		while (n == -1 && S_error == S_EINTR);
+		if (n == -1)
+			return IsBlocking() ? (ssize_t)sent : -1;
+#endif
+		rope_consume(r, n);
+		sent += n;
+		if (n == 0)
 			break;
-		}
+	}
+
+	return sent;
+}
 
-		t_bytes += n;
-		r_bytes -= n;
+/* Queue @b or @r after what is already waiting, the connection owns it
+ * now.  */
+static bool wq_push(conn_t *conn, buffer_t *b, rope_t *r)
+{
+	struct wq_entry *e = wq_entry_alloc();
+
+	if (!e) {
+		if (b)
+			bfree(b);
+		rope_free(r);
+		return false;
 	}
 
+	e->buf = b;
+	e->rope = r;
+	e->next = NULL;
+	*conn->wq_tail = e;
+	conn->wq_tail = &e->next;
 	return true;
 }
 
-static bool do_write_queue(conn_t *conn)
+static void wq_pop(conn_t *conn)
 {
-	int t_bytes = 0, r_bytes, n;
-	struct sk_buff *skb;
+	struct wq_entry *e = conn->wq_head;
+
+	conn->wq_head = e->next;
+	if (!conn->wq_head)
+		conn->wq_tail = &conn->wq_head;
+	if (e->buf)
+		bfree(e->buf);
+	rope_free(e->rope);
+	wq_entry_free(e);
+}
 
-	skb = &conn->wb;
-	r_bytes = skb->size;
+static bool do_write(conn_t *conn, const void *data, size_t len)
+{
+	ssize_t n = 0;
+	buffer_t *b;
+
+	/* Nothing may overtake what's already queued.  */
+	if (!conn->wq_head) {
+		n = send_some(conn->fd, data, len);
+		if (n < 0)
+			return false;
+		if ((size_t)n == len)
+			return true;
+	}
 
-	might_bug();
-	while (t_bytes < skb->size) {
-		do
-			n = send(conn->fd, skb->data + t_bytes, r_bytes, 0);
-		while (n == -1 && S_error == S_EINTR);
-		if (n == -1) {
-			if (IsBlocking() && r_bytes > 0) {
-				/* Not everything has been sent yet...  Store for next.
-				 * XXX Get rid of memmove.  */
-				memmove(skb->data, skb->data + t_bytes, r_bytes);
-				skb->size = r_bytes;
+	/* The caller keeps @data, so the rest has to be copied.  */
+	b = balloc(len - n);
+	__baddbytes(b, (const char *)data + n, len - n);
+	return wq_push(conn, b, NULL);
+}
+
+/* Send the queued buffers, returns false if the connection is broken.  */
+static bool do_write_queue(conn_t *conn)
+{
+	buffer_t *b;
+	ssize_t n;
+
+	while (conn->wq_head) {
+		if (conn->wq_head->rope) {
+			if (send_rope(conn->fd, conn->wq_head->rope) < 0)
 				return false;
-			}
-			break;
+			if (rope_len(conn->wq_head->rope))
+				break;	/* Socket is full, try again later.  */
+			wq_pop(conn);
+			continue;
 		}
 
-		t_bytes += n;
-		r_bytes -= n;
-	}
+		b = conn->wq_head->buf;
+		n = send_some(conn->fd, (const char *)b->data + b->rpos,
+			      b->wpos - b->rpos);
+		if (n < 0)
+			return false;
 
-	skb->size = 0;
-	free(skb->data);
-	skb->data = NULL;
+		b->rpos += n;
+		if (b->rpos != b->wpos)
+			break;
+		wq_pop(conn);
+	}
 
 	return true;
 }
@@ -200,10 +266,10 @@ static __exit __used void __sock_cleanup(void)
 	if (io_events)
 		pollev_deinit(io_events);
 
-	htable_clear(&conns);
+	conn_map_clear(&conns);
 	list_for_each_safe(&listeners, li, next, node) {
 		list_del(&li->node);
-		free(li);
+		listener_free(li);
 	}
 }
 
@@ -381,7 +447,11 @@ bool _new_listener(const char *service,
 	}
 	freeaddrinfo(addr);
 
-	xmalloc(ret, sizeof(*ret), S_close(fd); return false);
+	ret = listener_zalloc();
+	if (!ret) {
+		S_close(fd);
+		return false;
+	}
 	
 	list_add_tail(&listeners, &ret->node);
 
@@ -425,7 +495,9 @@ bool free_conn(conn_t *conn)
 	if (S_close(conn->fd) == 0)
 		retval = true;
 
-	free(conn);
+	while (conn->wq_head)
+		wq_pop(conn);
+	conn_free(conn);
 	return retval;
 }
 
@@ -448,12 +520,14 @@ conn_t *_new_conn_fd(int fd,
 		return NULL;
 	}
 
-	xmalloc(ret, sizeof(*ret), return NULL);
+	ret = conn_zalloc();
+	if (!ret)
+		return NULL;
 	ret->fd		= fd;
 	ret->fn		= fn;
 	ret->farg	= arg;
-	ret->wb.data	= NULL;
-	ret->wb.size	= 0;
+	ret->wq_head	= NULL;
+	ret->wq_tail	= &ret->wq_head;
 	ret->in_progress = true;
 	ret->next = NULL;
 	ret->argp = NULL;
@@ -479,6 +553,78 @@ bool conn_read(conn_t *conn, void *data, size_t *len)
 	return !(count <= 0 && !IsBlocking());
 }
 
+bool conn_read_buffer(conn_t *conn, buffer_t *b, size_t *len)
+{
+	ssize_t count;
+	if (!conn)
+		return false;
+	if (!breserve(b, *len)) {
+		*len = 0;
+		return false;
+	}
+
+	S_seterror(0);
+	do
+		count = recv(conn->fd, b->data + b->wpos, *len, 0);
+	while (count == -1 && S_error == S_EINTR);
+	if (count <= 0)
+		*len = 0;
+	else {
+		*len = count;
+		b->wpos += count;
+	}
+	return !(count <= 0 && !IsBlocking());
+}
+
+bool conn_write_buffer(conn_t *conn, buffer_t *b)
+{
+	ssize_t n;
+
+	if (!conn) {
+		bfree(b);
+		return false;
+	}
+
+	if (!conn->wq_head) {
+		n = send_some(conn->fd, (const char *)b->data + b->rpos,
+			      b->wpos - b->rpos);
+		if (n < 0) {
+			bfree(b);
+			return false;
+		}
+
+		b->rpos += n;
+		if (b->rpos == b->wpos) {
+			bfree(b);
+			return true;
+		}
+	}
+
+	return wq_push(conn, b, NULL);
+}
+
+bool conn_write_rope(conn_t *conn, rope_t *r)
+{
+	if (!conn) {
+		rope_free(r);
+		return false;
+	}
+
+	if (!conn->wq_head) {
+		if (send_rope(conn->fd, r) < 0) {
+			rope_free(r);
+			return false;
+		}
+
+		if (!rope_len(r)) {
+			rope_free(r);
+			return true;
+		}
+	}
+
+	return wq_push(conn, NULL, r);
+}
+
 bool conn_write(conn_t *conn, const void *data, size_t len)
 {
 	if (!conn)
@@ -591,7 +737,7 @@ void *conn_loop(void)
 					list_del(&li->node);
 					pollev_del(io_events, li->fd);
 					S_close(li->fd);
-					free(li);
+					listener_free(li);
 					continue;
 				}
 
@@ -643,11 +789,11 @@ void *conn_loop(void)
 						} else /* Disconnected?  */
 							free_conn(conn);
 						continue;
-					} else if (conn->wb.data) {
+					} else if (conn->wq_head) {
 #ifdef _DEBUG_SOCKET
 						eprintf("sending incomplete data...\n");
 #endif
-						if (!do_write_queue(conn) && !IsBlocking())
+						if (!do_write_queue(conn))
 							free_conn(conn);
 						continue;
 					}
@@ -12,6 +12,8 @@ bool stack_init(stack_t *s, size_t size)
 	if (!s->ptr)
 		return false;
 	s->size = size;
+	s->len = 0;
+	s->hint = 0;
 	return true;
 }
 
@@ -19,23 +21,31 @@ void stack_free(stack_t *s, bool freeAll)
 {
 	int i;
 
-	for (i = 0; i < s->size; ++i)
-		if (s->ptr[i])
-			free(s->ptr[i]);
+	if (freeAll)
+		for (i = 0; i < s->size; ++i)
+			if (s->ptr[i])
+				free(s->ptr[i]);
 
 	free(s->ptr);
 	s->size = 0;
+	s->len = 0;
+	s->hint = 0;
 	s->ptr = NULL;
 }
 
 bool stack_grow(stack_t *s, int new_size)
 {
-	void *tmp;
+	void **tmp;
+
+	if (new_size <= s->size)
+		return true;
 
 	tmp = realloc(s->ptr, new_size * sizeof(void *));
 	if (!tmp)
 		return false;
 
+	/* Empty slots are NULL.  */
+	memset(&tmp[s->size], 0, (new_size - s->size) * sizeof(void *));
 	s->ptr = tmp;
 	s->size = new_size;
 	return true;
@@ -46,29 +56,60 @@ int stack_push(stack_t *s, void *ptr, int where, void (*constructor) (void *))
 	int place = where;
 
 	if (place < 0) {
-		/* Find the first empty place.  */
-		for (place = 0; place < s->size && s->ptr[place]; ++place);
+		/* Find the first empty place, nothing below the hint is.  */
+		for (place = s->hint; place < s->size && s->ptr[place]; ++place);
 		/* If there's no space left, reallocate  */
-		if (place == s->size && s->ptr[place] != NULL
-		    && !stack_grow(s, s->size * SIZE_INCREMENT))
+		if (place == s->size
+		    && !stack_grow(s, s->size ? s->size * SIZE_INCREMENT : INITIAL_SIZE))
+			return -1;
+		s->hint = place + 1;
+	} else if (place >= s->size) {
+		int new_size = s->size ? s->size * SIZE_INCREMENT : INITIAL_SIZE;
+
+		if (new_size <= place)
+			new_size = place + 1;
+		if (!stack_grow(s, new_size))
 			return -1;
-	} else if (place > s->size && !stack_grow(s, place * SIZE_INCREMENT))
-		return -1;
+	}
 
 	s->ptr[place] = ptr;
+	if (place >= s->len)
+		s->len = place + 1;
 	if (constructor)
 		(*constructor) (ptr);
 	return place;
 }
 
+/* Drop the empty slots at the top.  */
+static void stack_trim(stack_t *s)
+{
+	while (s->len > 0 && !s->ptr[s->len - 1])
+		s->len--;
+}
+
 void *stack_pop(stack_t *s)
 {
-	return s ? s->ptr[--s->size] : NULL;
+	void *ret;
+
+	if (!s)
+		return NULL;
+	stack_trim(s);
+	if (!s->len)
+		return NULL;
+
+	ret = s->ptr[--s->len];
+	s->ptr[s->len] = NULL;
+	if (s->hint > s->len)
+		s->hint = s->len;
+	return ret;
 }
 
 void *stack_top(stack_t *s)
 {
-	return s ? s->ptr[s->size - 1] : NULL;
+	if (!s)
+		return NULL;
+	stack_trim(s);
+	return s->len ? s->ptr[s->len - 1] : NULL;
 }
 
 bool stack_remove(stack_t *s, void *ptr, bool (*compare_function) (const void *, const void *),
@@ -86,6 +127,8 @@ bool stack_remove(stack_t *s, void *ptr, bool (*compare_function) (const void *,
 				else
 					(*destructor) (s->ptr[i]);
 				s->ptr[i] = NULL;
+				if (s->hint > i)
+					s->hint = i;
 			}
 		} else {
 			r = (*compare_function) (s->ptr[i], ptr);
@@ -95,6 +138,8 @@ bool stack_remove(stack_t *s, void *ptr, bool (*compare_function) (const void *,
 				else
 					(*destructor) (s->ptr[i]);
 				s->ptr[i] = NULL;
+				if (s->hint > i)
+					s->hint = i;
 			}
 		}
 
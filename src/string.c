@@ -1,70 +1,230 @@
 /* Public Domain */
 #include <csnippets/string.h>
+#include <csnippets/arena.h>
 
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 
+/*
+ * The SSE2 paths below only decide about ASCII bytes, which are the same
+ * in every locale (see ascii_case_ok() for the one exception), anything
+ * with the high bit set is handed to the ctype function like before so
+ * the results don't change.  Without SSE2 the same is done a byte at a
+ * time.  Delimiter search uses memchr(), the C library already has a
+ * vectorized one.
+ */
+#ifdef __SSE2__
+#include <emmintrin.h>
+#define SIMD_WIDTH	16
+
+static inline __m128i simd_load(const char *p)
+{
+	return _mm_loadu_si128((const __m128i *)p);
+}
+
+/* Bytes of @x in [@lo, @hi], @x must not have bytes >= 0x80.  */
+static inline __m128i simd_in_range(__m128i x, char lo, char hi)
+{
+	return _mm_and_si128(_mm_cmpgt_epi8(x, _mm_set1_epi8(lo - 1)),
+			     _mm_cmplt_epi8(x, _mm_set1_epi8(hi + 1)));
+}
+
+/* Bitmask of the bytes that are " \t\n\v\f\r".  */
+static inline int simd_space_mask(const char *p)
+{
+	__m128i x = simd_load(p);
+
+	return _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8(' ')),
+					      simd_in_range(x, '\t', '\r')));
+}
+#endif
+
+/* The number of @c in s[0, len).  */
+static size_t strcount(const char *s, size_t len, char c)
+{
+	size_t n = 0, i = 0;
+
+#ifdef SIMD_WIDTH
+	__m128i v = _mm_set1_epi8(c);
+
+	for (; i + SIMD_WIDTH <= len; i += SIMD_WIDTH)
+		n += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(simd_load(s + i), v)));
+#endif
+	for (; i < len; i++)
+		n += s[i] == c;
+	return n;
+}
+
 char *strtrim(char *str)
 {
-	char *end;
+	size_t start = 0, end = strlen(str);
 
-	/* trim leading spaces */
-	while (isspace(*str)) str++;
+#ifdef SIMD_WIDTH
+	int mask;
 
-	if (*str == 0)   /* all spaces? */
-		return str;
+	/* Skip whole blocks of spaces, then let isspace() look at the rest
+	 * (it's either the first non-space or a non-ASCII byte).  */
+	while (start + SIMD_WIDTH <= end) {
+		mask = simd_space_mask(str + start);
+		if (mask != 0xffff) {
+			start += __builtin_ctz(~mask);
+			break;
+		}
+		start += SIMD_WIDTH;
+	}
+#endif
+	while (isspace(str[start]))
+		start++;
 
-	end = str + strlen(str) -1;
-	while (end > str && isspace(*end)) end--;
+	if (start == end)	/* all spaces? */
+		return str + start;
+
+#ifdef SIMD_WIDTH
+	while (end - start >= SIMD_WIDTH) {
+		mask = simd_space_mask(str + end - SIMD_WIDTH);
+		if (mask != 0xffff) {
+			/* Keep up to the last non-space.  */
+			end -= __builtin_clz((unsigned)(~mask & 0xffff) << 16);
+			break;
+		}
+		end -= SIMD_WIDTH;
+	}
+#endif
+	while (end > start && isspace(str[end - 1]))
+		end--;
 
-	*(end+1) = '\0';
-	return str;
+	str[end] = '\0';
+	return str + start;
 }
 
 char **strexplode(char *string, char separator, int *size)
 {
-	int start = 0, i, k = 0, count = 2;
+	size_t len = strlen(string), n;
+	int i = 0, count = strcount(string, len, separator) + 1;
+	const char *tok;
 	char **strarr;
-	for (i = 0; string[i] != '\0'; i++)
-		if (string[i] == separator)
-			count++;
-
-	*size = count-1;
-	strarr = calloc(count, sizeof(char*));
-	i = 0;
-	while (*string != '\0') {
-		if (*string == separator) {
-			strarr[i] = calloc(k - start + 2,sizeof(char));
-			strncpy(strarr[i], string - k + start, k - start);
-			strarr[i][k - start + 1] = '\0'; /* ensure null termination */
-			start = k;
-			start++;
-			i++;
-		}
-		string++;
-		k++;
+	strsplit_t s;
+
+	strarr = malloc((count + 1) * sizeof(char *));
+	if (!strarr)
+		return NULL;
+
+	/* Each token is allocated on its own, callers free them one by one.  */
+	strsplit_init(&s, string, len, separator);
+	for (; strsplit_next(&s, &tok, &n); i++) {
+		if (!(strarr[i] = malloc(n + 1)))
+			goto fail;
+		memcpy(strarr[i], tok, n);
+		strarr[i][n] = '\0';
 	}
+	strarr[i] = NULL;
+
+	*size = count;
+	return strarr;
+
+fail:
+	while (i--)
+		free(strarr[i]);
+	free(strarr);
+	return NULL;
+}
+
+char **strexplode_arena(struct arena *a, const char *string, char separator,
+			int *size)
+{
+	size_t len = strlen(string);
+	int i = 0, count = 1;
+	char **strarr, *copy, *p;
 
-	strarr[i] = calloc(k - start + 1,sizeof(char));
-	strncpy(strarr[i], string - k + start, k - start);
-	strarr[++i] = NULL;
+	for (p = (char *)string; (p = memchr(p, separator, string + len - p)); p++)
+		count++;
 
+	/* One copy of the string, cut in place.  */
+	strarr = arena_alloc(a, (count + 1) * sizeof(char *));
+	copy = arena_memdup(a, string, len + 1);
+	if (!strarr || !copy)
+		return NULL;
+
+	strarr[i++] = copy;
+	for (p = copy; (p = memchr(p, separator, copy + len - p)); ) {
+		*p++ = '\0';
+		strarr[i++] = p;
+	}
+	strarr[i] = NULL;
+
+	*size = count;
 	return strarr;
 }
 
 int strwildmatch(const char *pattern, const char *string)
 {
-	switch (*pattern) {
-	case '\0':
-		return *string;
-	case '*':
-		return !(!strwildmatch(pattern+1, string) || (*string && !strwildmatch(pattern, string+1)));
-	case '?':
-		return !(*string && !strwildmatch(pattern+1, string+1));
-	default:
-		return !((toupper(*pattern) == toupper(*string)) && !strwildmatch(pattern+1, string+1));
+	const char *star = NULL, *retry = NULL;
+
+	/* On a mismatch, only go back to the last star and let it take one
+	 * more character: an earlier star could only shift the part matched
+	 * since then, which the last star already covers.  */
+	while (*string) {
+		if (*pattern == '*') {
+			while (*++pattern == '*')
+				;
+			if (!*pattern)
+				return 0;
+			star = pattern;
+			retry = string;
+		} else if (*pattern == '?' || (*pattern && (*pattern == *string
+				|| toupper(*pattern) == toupper(*string)))) {
+			pattern++;
+			string++;
+		} else if (star) {
+			pattern = star;
+			string = ++retry;
+		} else
+			return 1;
 	}
+
+	while (*pattern == '*')
+		pattern++;
+	return *pattern != '\0';
+}
+
+/* Turkish locales map 'I' to a dotless i, the ASCII shortcuts are only
+ * right if @conv leaves it alone.  */
+static bool ascii_case_ok(int (*conv) (int))
+{
+	if (conv == tolower)
+		return tolower('I') == 'i';
+	if (conv == toupper)
+		return toupper('i') == 'I';
+	return false;
+}
+
+/* strccmp() for islower/isupper: true if every byte in s[0, len) is in
+ * [@lo, @hi], bytes >= 0x80 are left to @cmp.  */
+static bool strccmp_range(const char *s, size_t len, char lo, char hi,
+			  int (*cmp) (int))
+{
+	size_t i = 0;
+
+#ifdef SIMD_WIDTH
+	__m128i x;
+
+	for (; i + SIMD_WIDTH <= len; i += SIMD_WIDTH) {
+		x = simd_load(s + i);
+		if (_mm_movemask_epi8(x))
+			break;
+		if (_mm_movemask_epi8(simd_in_range(x, lo, hi)) != 0xffff)
+			return false;
+	}
+#endif
+	for (; i < len; i++) {
+		if (s[i] & 0x80) {
+			if (!cmp((int)s[i]))
+				return false;
+		} else if (s[i] < lo || s[i] > hi)
+			return false;
+	}
+	return true;
 }
 
 bool strccmp(const char *str, int (*cmp) (int))
@@ -72,12 +232,48 @@ bool strccmp(const char *str, int (*cmp) (int))
 	register const char *p = str;
 	if (!str || !cmp)
 		return false;
+
+	if (cmp == islower && ascii_case_ok(tolower))
+		return strccmp_range(str, strlen(str), 'a', 'z', cmp);
+	if (cmp == isupper && ascii_case_ok(toupper))
+		return strccmp_range(str, strlen(str), 'A', 'Z', cmp);
+
 	while (*p)
 		if (!cmp((int)*p++))
 			return false;
 	return true;
 }
 
+/* Flip the case of the letters in [@lo, @hi] from @src to @dst, bytes >=
+ * 0x80 go through @conv.  */
+static void strconv_ascii(char *dst, const char *src, size_t len,
+			  char lo, char hi, int (*conv) (int))
+{
+	size_t i = 0;
+
+#ifdef SIMD_WIDTH
+	__m128i x, flip = _mm_set1_epi8(0x20);
+
+	for (; i + SIMD_WIDTH <= len; i += SIMD_WIDTH) {
+		x = simd_load(src + i);
+		if (unlikely(_mm_movemask_epi8(x))) {
+			size_t j;
+
+			for (j = i; j < i + SIMD_WIDTH; j++)
+				dst[j] = src[j] & 0x80 ? conv(src[j])
+					: src[j] >= lo && src[j] <= hi ? src[j] ^ 0x20 : src[j];
+			continue;
+		}
+
+		x = _mm_xor_si128(x, _mm_and_si128(simd_in_range(x, lo, hi), flip));
+		_mm_storeu_si128((__m128i *)(dst + i), x);
+	}
+#endif
+	for (; i < len; i++)
+		dst[i] = src[i] & 0x80 ? conv(src[i])
+			: src[i] >= lo && src[i] <= hi ? src[i] ^ 0x20 : src[i];
+}
+
 char *strconv(const char *str, int (*conv) (int))
 {
 	int len;
@@ -88,9 +284,15 @@ char *strconv(const char *str, int (*conv) (int))
 		return NULL;
 	len = strlen(str);
 	xmalloc(ret, len + 1, return NULL);
-	for (i = 0; i < len; ++i)
-		ret[i] = conv(str[i]);
-	ret[i + 1] = '\0';
+
+	if (conv == tolower && ascii_case_ok(conv))
+		strconv_ascii(ret, str, len, 'A', 'Z', conv);
+	else if (conv == toupper && ascii_case_ok(conv))
+		strconv_ascii(ret, str, len, 'a', 'z', conv);
+	else
+		for (i = 0; i < len; ++i)
+			ret[i] = conv(str[i]);
+	ret[len] = '\0';
 	return ret;
 }
 
@@ -4,6 +4,7 @@
  */
 #include <csnippets/list.h>
 #include <csnippets/task.h>
+#include <csnippets/pool.h>
 
 #include <pthread.h>
 
@@ -13,6 +14,8 @@ typedef struct task {
 	struct list_node node;
 } task_t;
 
+POOL_DEFINE_CACHED_TYPE(task_t, task);
+
 static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t  cond  = PTHREAD_COND_INITIALIZER;
 static LIST_HEAD(tasks);
@@ -43,7 +46,7 @@ static void *tasks_thread(void __unused *unused)
 		pthread_mutex_unlock(&mutex);
 
 		(*task->start_routine) (task->param);
-		free(task);
+		task_free(task);
 	}
 
 	/* Execute any task waiting */
@@ -53,7 +56,7 @@ static void *tasks_thread(void __unused *unused)
 		pthread_mutex_unlock(&mutex);
 
 		(*task->start_routine) (task->param);
-		free(task);
+		task_free(task);
 	}
 
 	return NULL;
@@ -96,7 +99,9 @@ task_t *task_create(task_routine routine, void *param)
 	if (!routine)
 		return NULL;
 
-	xmalloc(task, sizeof(task_t), return NULL);
+	task = task_alloc();
+	if (!task)
+		return NULL;
 
 	task->start_routine = routine;
 	task->param = param;
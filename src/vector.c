@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2013 Ahmed Samy  <f.fallen45@gmail.com>
+ * Licensed under MIT, see LICENSE.MIT for details.
+ */
+#include <csnippets/vector.h>
+
+bool vector_init(vector_t *v, size_t cap)
+{
+	vector_t empty = VECTOR_INITIALIZER;
+
+	*v = empty;
+	return cap == 0 || vector_reserve(v, cap);
+}
+
+void vector_free(vector_t *v, void (*destructor) (void *))
+{
+	size_t i;
+
+	if (destructor)
+		for (i = 0; i < v->len; i++)
+			if (v->items[i])
+				destructor(v->items[i]);
+
+	free(v->items);
+	free(v->holes);
+	vector_init(v, 0);
+}
+
+bool vector_reserve(vector_t *v, size_t cap)
+{
+	size_t ncap = v->cap ? v->cap : VECTOR_MIN_SIZE;
+	void **tmp;
+
+	if (cap <= v->cap)
+		return true;
+	while (ncap < cap)
+		ncap *= 2;
+
+	tmp = realloc(v->items, ncap * sizeof(void *));
+	if (!tmp)
+		return false;
+
+	v->items = tmp;
+	v->cap = ncap;
+	return true;
+}
+
+void *vector_remove(vector_t *v, size_t i)
+{
+	void *item = v->items[i];
+
+	memmove(&v->items[i], &v->items[i + 1], (v->len - i - 1) * sizeof(void *));
+	v->len--;
+	return item;
+}
+
+long vector_slot_add(vector_t *v, void *item)
+{
+	size_t i;
+
+	if (v->nholes) {
+		i = v->holes[--v->nholes];
+		v->items[i] = item;
+		return i;
+	}
+
+	if (!vector_push(v, item))
+		return -1;
+
+	/* Keep room for every slot to become a hole, so that
+	 * vector_slot_del() can't fail.  */
+	if (v->holes_cap < v->cap) {
+		size_t *tmp = realloc(v->holes, v->cap * sizeof(size_t));
+
+		if (!tmp) {
+			v->len--;
+			return -1;
+		}
+		v->holes = tmp;
+		v->holes_cap = v->cap;
+	}
+
+	return v->len - 1;
+}
+
+void *vector_slot_del(vector_t *v, size_t i)
+{
+	void *item = v->items[i];
+
+	assert(v->nholes < v->holes_cap);
+	v->items[i] = NULL;
+	v->holes[v->nholes++] = i;
+	return item;
+}
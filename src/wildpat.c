@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2013 Ahmed Samy  <f.fallen45@gmail.com>
+ * Licensed under MIT, see LICENSE.MIT for details.
+ */
+#include <csnippets/wildpat.h>
+
+#include <ctype.h>
+
+/* A literal run of the pattern, folded to upper case.  '?' matches any
+ * character.  */
+struct wildseg {
+	const uint8_t *pat;
+	size_t len;
+
+	/* The bytes a match can start with, if there are at most two of
+	 * them, so that candidates can be found with memchr().  */
+	int nfirst;
+	uint8_t first[2];
+};
+
+struct wildpat {
+	uint8_t upper[256];
+	bool star_start, star_end;	/* the pattern starts/ends with '*' */
+	size_t minlen;			/* shortest string that can match */
+
+	size_t nsegs;
+	struct wildseg *segs;
+	uint8_t *buf;
+};
+
+static void wildseg_init_first(const wildpat_t *w, struct wildseg *seg)
+{
+	int c;
+
+	seg->nfirst = 0;
+	if (!seg->len || seg->pat[0] == '?')
+		return;
+
+	for (c = 0; c < 256; c++) {
+		if (w->upper[c] != seg->pat[0])
+			continue;
+		if (seg->nfirst == 2) {
+			seg->nfirst = 0;
+			return;
+		}
+		seg->first[seg->nfirst++] = c;
+	}
+}
+
+wildpat_t *wildpat_compile(const char *pattern)
+{
+	size_t len = strlen(pattern), i, n;
+	struct wildseg *seg;
+	wildpat_t *w;
+	uint8_t *p;
+
+	xmalloc(w, sizeof(*w), return NULL);
+	for (i = 0; i < 256; i++)
+		w->upper[i] = toupper(i);
+
+	/* At most one run more than there are stars.  */
+	n = 1;
+	for (i = 0; i < len; i++)
+		n += pattern[i] == '*';
+
+	w->segs = malloc(n * sizeof(*w->segs));
+	w->buf = malloc(len + 1);
+	if (!w->segs || !w->buf) {
+		wildpat_free(w);
+		return NULL;
+	}
+
+	w->star_start = pattern[0] == '*';
+	w->star_end = len && pattern[len - 1] == '*';
+
+	for (i = 0, p = w->buf; i <= len; ) {
+		size_t start = i;
+
+		while (i < len && pattern[i] != '*')
+			i++;
+
+		/* Empty runs only come from consecutive stars (or a star at
+		 * either end), drop them unless there is no star at all.  */
+		if (i > start || (!w->nsegs && i == len && !w->star_start)) {
+			seg = &w->segs[w->nsegs++];
+			seg->pat = p;
+			seg->len = i - start;
+			for (; start < i; start++) {
+				uint8_t c = pattern[start];
+
+				*p++ = c == '?' ? '?' : w->upper[c];
+			}
+			wildseg_init_first(w, seg);
+			w->minlen += seg->len;
+		}
+		i++;
+	}
+
+	return w;
+}
+
+void wildpat_free(wildpat_t *w)
+{
+	if (!w)
+		return;
+
+	free(w->segs);
+	free(w->buf);
+	free(w);
+}
+
+static inline bool wildseg_eq(const wildpat_t *w, const struct wildseg *seg,
+			      const uint8_t *s)
+{
+	size_t i;
+
+	for (i = 0; i < seg->len; i++)
+		if (seg->pat[i] != '?' && seg->pat[i] != w->upper[s[i]])
+			return false;
+	return true;
+}
+
+/* The leftmost match of @seg starting in [@s, @last].  */
+static const uint8_t *wildseg_find(const wildpat_t *w, const struct wildseg *seg,
+				   const uint8_t *s, const uint8_t *last)
+{
+	/* The next occurrence of each of seg->first, so that none of the
+	 * string is searched twice.  */
+	const uint8_t *next[2] = { NULL, NULL };
+	int k;
+
+	for (; s <= last; s++) {
+		if (seg->nfirst) {
+			const uint8_t *c = last + 1;
+
+			for (k = 0; k < seg->nfirst; k++) {
+				if (!next[k] || next[k] < s) {
+					next[k] = memchr(s, seg->first[k], last - s + 1);
+					if (!next[k])
+						next[k] = last + 1;
+				}
+				if (next[k] < c)
+					c = next[k];
+			}
+			if (c > last)
+				return NULL;
+			s = c;
+		}
+
+		if (wildseg_eq(w, seg, s))
+			return s;
+	}
+
+	return NULL;
+}
+
+bool wildpat_matchn(const wildpat_t *w, const char *str, size_t len)
+{
+	const uint8_t *s = (const uint8_t *)str, *end = s + len;
+	const struct wildseg *seg = w->segs, *last = w->segs + w->nsegs;
+
+	if (len < w->minlen)
+		return false;
+
+	/* No star, the only run must be the whole string.  */
+	if (!w->star_start && !w->star_end && w->nsegs == 1)
+		return len == seg->len && wildseg_eq(w, seg, s);
+
+	if (!w->star_start) {
+		if (!wildseg_eq(w, seg, s))
+			return false;
+		s += seg->len;
+		seg++;
+	}
+
+	if (!w->star_end) {
+		last--;
+		if (end - s < (ptrdiff_t)last->len || !wildseg_eq(w, last, end - last->len))
+			return false;
+		end -= last->len;
+	}
+
+	/* Taking the leftmost match of each run leaves the most room for
+	 * the following ones, so there's never a reason to go back.  */
+	for (; seg < last; seg++) {
+		if (end - s < (ptrdiff_t)seg->len)
+			return false;
+		s = wildseg_find(w, seg, s, end - seg->len);
+		if (!s)
+			return false;
+		s += seg->len;
+	}
+
+	return true;
+}
+
+bool wildpat_match(const wildpat_t *w, const char *str)
+{
+	return wildpat_matchn(w, str, strlen(str));
+}